@@ -28,13 +28,93 @@
  * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  *******************************************************************************/ 
 #include "Earl.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <limits>
+#include <sstream>
+
+#ifndef _WIN32
+	#include <cerrno>
+	#include <csignal>
+	#include <sys/resource.h>
+	#include <sys/wait.h>
+	#include <unistd.h>
+#endif
+
+// First line of a result cache file.
+#define CACHE_HEADER "earl-cache 2"
+// First line of a stability statistics file.
+#define STATS_HEADER "earl-stats 1"
+// Prefixes the lines Test::stress prints.
+#define STRESS_OUTPUT "\tstress => "
+// Prefixes the lines Test::scalability prints.
+#define SCALING_OUTPUT "\tscaling => "
+// Prefixes the lines Test::fuzz prints.
+#define FUZZ_OUTPUT "\tfuzz => "
 
 namespace Earl {
-	int Test::testsRun = 0;
-	int Test::testsFailed = 0;
+	/**
+	 * envFlag
+	 * -------------------
+	 * Returns whether the environment variable name is set
+	 * to anything other than 0.
+	 */
+	static bool envFlag(const char* name) {
+		const char* value = std::getenv(name);
+		return value != nullptr && std::strcmp(value, "0") != 0;
+	}
+
+	/**
+	 * envString
+	 * -------------------
+	 * Returns the environment variable name, or an
+	 * empty string if it is not set.
+	 */
+	static std::string envString(const char* name) {
+		const char* value = std::getenv(name);
+		return value != nullptr ? value : "";
+	}
+
+	std::atomic<int> Test::testsRun(0);
+	std::atomic<int> Test::testsFailed(0);
+	std::atomic<int> Test::testsCached(0);
+	std::atomic<int> Test::testsFlaky(0);
 	int Test::maxThreads = DEFAULT_MAX_THREADS;
+	int Test::threadLimit = std::atoi(envString("EARL_MAX_THREADS").c_str());
+	int Test::maxRetries = 0;
 	bool Test::runAsync = false;
+	bool Test::fullRun = envFlag("EARL_FULL_RUN");
 	std::string Test::currentSuite = "";
+	std::string Test::currentCacheKey = "";
+	Resources Test::currentResources;
+	std::string Test::cacheFile = "";
+	std::string Test::binaryCacheKey = "";
+	// The entries of the result cache, by key.
+	std::unordered_map<uint64_t, CachedResult> Test::cachedResults;
+	// Keys of the tests which passed (or were cached) in this run, with their cache scopes.
+	std::unordered_map<uint64_t, uint64_t> Test::passedResults;
+	// Keys of the tests which failed or were flaky in this run.
+	std::unordered_set<uint64_t> Test::failedResults;
+	// The cache scopes of every test made since the cache was opened.
+	std::unordered_set<uint64_t> Test::cacheScopes;
+	uint64_t Test::cacheOwner = 0;
+	std::string Test::statsFile = "";
+	std::string Test::traceFile = "";
+	std::vector<int> Test::cpuSet;
+	bool Test::numaSpread = false;
+	bool Test::trackUsage = false;
+	bool Test::isolated = false;
+	std::string Test::fuzzCorpus = "";
+	size_t Test::fuzzRuns = DEFAULT_FUZZ_RUNS;
+	std::string Test::filter = envString("EARL_FILTER");
+	int Test::shardIndex = std::atoi(envString("EARL_SHARD_INDEX").c_str());
+	int Test::shardCount = std::max(std::atoi(envString("EARL_TOTAL_SHARDS").c_str()), 1);
+	// Stability statistics of every test seen, keyed on suite and description.
+	std::unordered_map<uint64_t, TestStats> Test::testStats;
 
 	// The list of functions run before the next test.
 	std::vector<std::function<void()>> Test::beforeList;
@@ -49,7 +129,8 @@ namespace Earl {
 	// Stores the descriptions of pending tests
 	std::vector<PendingTestCase> Test::pendingTest;
 
-	std::mutex Test::testCountMutex;
+	// One list of results per worker, merged at the end of Test::runTests.
+	std::vector<ResultSlab> Test::resultSlabs;
 
 	/**
 	 * Test::initSuite
@@ -66,10 +147,18 @@ namespace Earl {
 		// Remove all the tests
 		testList.clear();
 		pendingTest.clear();
+		Metrics::setPending(0);
 		// Initialise the results.
 		testsRun = 0;
 		testsFailed = 0;
+		testsCached = 0;
+		testsFlaky = 0;
+		passedResults.clear();
+		failedResults.clear();
+		resultSlabs.clear();
 		currentSuite = "";
+		currentCacheKey = "";
+		currentResources = Resources();
 	}
 
 	/**
@@ -88,6 +177,43 @@ namespace Earl {
 		lambda();
 	}
 
+	/**
+	 * Test::describe
+	 * -------------------
+	 * Describe a set of tests to be executed, with the key their results
+	 * are cached under. Tests which passed against the same key in the
+	 * previous run are skipped. Without a key, a hash of the test binary
+	 * is used.
+	 * @param description - Describes the set of tests to be run
+	 * @param cacheKey - Changes whenever the tests' results may change
+	 * @param lambda - The function to run, after the description has been printed.
+	 */
+	void Test::describe(std::string description, std::string cacheKey, std::function<void()> lambda) {
+		std::string outer = currentCacheKey;
+
+		currentCacheKey = cacheKey;
+		describe(description, lambda);
+		currentCacheKey = outer;
+	}
+
+	/**
+	 * Test::describe
+	 * -------------------
+	 * Describe a set of tests to be executed which all need the same
+	 * resources, in addition to any each test declares itself.
+	 * @param description - Describes the set of tests to be run
+	 * @param resources - The locks and weight of each test in the set
+	 * @param lambda - The function to run, after the description has been printed.
+	 */
+	void Test::describe(std::string description, Resources resources, std::function<void()> lambda) {
+		Resources outer = currentResources;
+
+		currentResources.locks.insert(currentResources.locks.end(), resources.locks.begin(), resources.locks.end());
+		currentResources.weight = std::max(currentResources.weight, resources.weight);
+		describe(description, lambda);
+		currentResources = outer;
+	}
+
 	/**
 	 * Test::it
 	 * -------------------
@@ -98,6 +224,164 @@ namespace Earl {
 	 * 					is said to have passed.
 	 */
 	void Test::it(std::string description, std::function<bool()> lambda) {
+		addTest(makeTest(description, lambda));
+	}
+
+	/**
+	 * Test::it
+	 * -------------------
+	 * Add one test which needs resources. When running asynchronously,
+	 * the test never overlaps another test holding one of its locks,
+	 * and counts its weight against the maximum concurrency.
+	 * @param description - Describes the function of the test
+	 * @param resources - The locks and weight the test needs
+	 * @param lambda - The test to run. If the test returns true, the test is
+	 * 					is said to have passed.
+	 */
+	void Test::it(std::string description, Resources resources, std::function<bool()> lambda) {
+		TestCase test = makeTest(description, lambda);
+
+		test.resources.locks.insert(test.resources.locks.end(), resources.locks.begin(), resources.locks.end());
+		test.resources.weight = std::max(test.resources.weight, resources.weight);
+		addTest(test);
+	}
+
+	/**
+	 * Test::benchmark
+	 * -------------------
+	 * Add a test which measures performance. Benchmarks run one at a
+	 * time on a core reserved for them, while the suite's other tests
+	 * run on the remaining cores. The time taken is printed alongside
+	 * the result.
+	 * @param description - Describes the function of the test
+	 * @param lambda - The test to run. If the test returns true, the test is
+	 * 					is said to have passed.
+	 */
+	void Test::benchmark(std::string description, std::function<bool()> lambda) {
+		TestCase test = makeTest(description, lambda);
+		test.benchmark = true;
+		addTest(test);
+	}
+
+	/**
+	 * Test::stress
+	 * -------------------
+	 * Add a test which runs a lambda on several threads at once, for
+	 * many iterations. Every thread is released from a spin barrier at
+	 * the start of each iteration, so that races show up within a
+	 * normal run. Failed iterations are counted per thread, and the
+	 * operations per second are printed. The test weighs as much as
+	 * its thread count.
+	 * @param description - Describes the function of the test
+	 * @param threads - The number of threads
+	 * @param iterations - The number of iterations on each thread
+	 * @param lambda - Called with the thread's index and the iteration;
+	 *				returns false if the iteration failed.
+	 * @param randomize - Randomly yield or spin after each release, to
+	 *				vary the interleaving. The seed is printed on failure,
+	 *				and can be replayed with EARL_STRESS_SEED.
+	 */
+	void Test::stress(std::string description, int threads, int iterations, std::function<bool(int, int)> lambda, bool randomize) {
+		it(description, Resources(std::vector<std::string>(), threads), [=]() -> bool {
+			StressReport report;
+			std::ostringstream summary;
+
+			unpinned([&]() {
+				report = Stress::run(threads, iterations, lambda, randomize, Stress::seed());
+			});
+
+			summary << STRESS_OUTPUT << report.threads << " threads x " << report.iterations << " iterations, "
+					<< std::fixed << std::setprecision(0) << report.operationsPerSecond() << " ops/sec";
+			Print::line(summary.str(), GREY);
+
+			for(int thread = 0; thread < report.threads; thread++) {
+				if(report.failures[thread] > 0) {
+					std::ostringstream failure;
+					failure << STRESS_OUTPUT << "thread " << thread << " failed " << report.failures[thread]
+							<< " of " << report.iterations << " iterations (first: " << report.firstFailure[thread] << ")";
+					Print::line(failure.str(), GREY);
+				}
+			}
+
+			if(report.failed() > 0 && randomize) {
+				std::ostringstream seed;
+				seed << STRESS_OUTPUT << "replay with EARL_STRESS_SEED=0x" << std::hex << report.seed;
+				Print::line(seed.str(), GREY);
+			}
+
+			return report.failed() == 0;
+		});
+	}
+
+	/**
+	 * Test::scalability
+	 * -------------------
+	 * Add a benchmark which runs a workload at 1, 2, 4... threads, up to
+	 * the hardware concurrency, and prints the throughput, speedup and
+	 * parallel efficiency of each step, flagging any step slower than
+	 * the one before. The test weighs as much as the hardware
+	 * concurrency, so it only shares the machine if the budget allows.
+	 * @param description - Describes the function of the test
+	 * @param iterations - The number of iterations on each thread
+	 * @param workload - Called with the thread's index and the iteration;
+	 *				returns false if the iteration failed.
+	 * @param check - Passed the measured curve, for assertions such as
+	 *				Assert::hasEfficiency. The test fails if it returns false.
+	 */
+	void Test::scalability(std::string description, int iterations, std::function<bool(int, int)> workload, std::function<bool(const std::vector<ScalingStep>&)> check) {
+		int cores = Test::cores();
+
+		it(description, Resources(std::vector<std::string>(), cores), [=]() -> bool {
+			int failures = 0;
+			std::vector<ScalingStep> steps;
+
+			unpinned([&]() {
+				steps = Stress::scale(iterations, workload, cores, &failures);
+			});
+
+			for(auto& step : steps) {
+				std::ostringstream line;
+
+				line << SCALING_OUTPUT << std::setw(3) << step.threads << (step.threads == 1 ? " thread: " : " threads: ") << std::fixed << std::setprecision(0)
+					 << step.throughput << " ops/sec, " << std::setprecision(2) << step.speedup << "x speedup, "
+					 << std::setprecision(0) << step.efficiency * 100 << "% efficiency";
+
+				if(step.negative) {
+					line << " (negative scaling)";
+				}
+
+				Print::line(line.str(), step.negative ? YELLOW : GREY);
+			}
+
+			return failures == 0 && (!check || check(steps));
+		});
+	}
+
+	/**
+	 * Test::makeTest
+	 * -------------------
+	 * Create a test case in the current suite, with the current
+	 * befores and afters.
+	 * @param description - Describes the function of the test
+	 * @param lambda - The test to run
+	 */
+	TestCase Test::makeTest(const std::string& description, const std::function<bool()>& lambda) {
+		uint64_t resultKey = 0, cacheScope = 0;
+
+		// Key the result on the suite's cache key (or the test binary),
+		// the suite and the description.
+		if(!cacheFile.empty()) {
+			const std::string& key = currentCacheKey.empty() ? binaryCacheKey : currentCacheKey;
+
+			if(!key.empty()) {
+				cacheScope = File::hash(key.c_str(), key.size() + 1);
+				cacheScopes.insert(cacheScope);
+				resultKey = File::hash(currentSuite.c_str(), currentSuite.size() + 1, cacheScope);
+				resultKey = File::hash(description.c_str(), description.size(), resultKey);
+				resultKey = resultKey == 0 ? 1 : resultKey;
+			}
+		}
+
 #ifdef _MSC_VER
 		TestCase test;
 		test.test = lambda;
@@ -105,220 +389,1374 @@ namespace Earl {
 		test.suite = currentSuite;
 		test.beforeList = beforeList;
 		test.afterList = afterList;
+		test.resultKey = resultKey;
+		test.cacheScope = cacheScope;
+		test.benchmark = false;
+		test.resources = currentResources;
+		test.generate = nullptr;
 #else
-		TestCase test { lambda, description, currentSuite, beforeList, afterList };
+		TestCase test { lambda, description, currentSuite, beforeList, afterList, resultKey, cacheScope, false, currentResources, nullptr };
 #endif
 
-		if(runAsync) {
+		return test;
+	}
+
+	/**
+	 * Test::addTest
+	 * -------------------
+	 * Queue a test, or run it straight away when running synchronously.
+	 * @param test - The test case to add
+	 */
+	void Test::addTest(const TestCase& test) {
+		// Tests which are filtered out are never stored.
+		if(!selected(test)) {
+			beforeList.clear();
+			afterList.clear();
+		} else if(runAsync) {
 			beforeList.clear();
 			afterList.clear();
 			testList.push_back(test);
 		} else {
-			runTest(std::make_shared<TestCase>(test));
+			// Synchronous tests run on the calling thread, as worker zero.
+			if(resultSlabs.empty()) {
+				resultSlabs.resize(1);
+			}
+
+			// Benchmarks borrow the reserved core for as long as they run.
+			std::vector<int> affinity;
+
+			if(test.benchmark) {
+				std::vector<int> cpus = placement();
+				affinity = Affinity::current();
+
+				if(!cpus.empty()) {
+					Affinity::pin(std::vector<int>(1, cpus.back()));
+				}
+			}
+
+			if(!skipCached(test, 0)) {
+				runTest(test, 0);
+			}
+
+			if(!affinity.empty()) {
+				Affinity::pin(affinity);
+			}
 		}
 	}
 
-	void Test::it(std::string description) {
-#ifdef _MSC_VER
-		PendingTestCase test;
-		test.description = description;
-		test.suite = suite;
-#else
-		PendingTestCase test { description, currentSuite };
-#endif
-		pendingTest.push_back(test);
-	}
-	
 	/**
-	 * Test::runAsynchronously
+	 * Test::fuzz
 	 * -------------------
-	 * Tell Earl to whether to run tests in an asynchronous manner.
-	 * @param async - Set to true to run tests asynchronously.
+	 * Add a test which fuzzes target with a coverage-guided mutation
+	 * loop, on one worker thread per core sharing a corpus. Each input
+	 * runs between the before-each and after-each functions; as those
+	 * share their fixtures, a single worker is used while there are
+	 * any. Build the code under test with -fsanitize-coverage=trace-pc-guard
+	 * (Clang) or -fsanitize-coverage=trace-pc (GCC) for coverage. The
+	 * test fails if an input makes target return false, throw or
+	 * crash; the input is minimised and, if there is a corpus, saved
+	 * to it. Inputs run in a child process where fork is available, so
+	 * a crash fails the test and their side effects stay in the child.
+	 * @param description - Describes the function of the test
+	 * @param target - Runs one input, returning false if it exposed a bug.
 	 */
-	void Test::runAsynchronously(bool async) {
-		runAsync = async;
-	}
+	void Test::fuzz(std::string description, std::function<bool(const uint8_t*, size_t)> target) {
+		int cores = Test::cores();
 
-	/**
-	 * Test::runTest
-	 * -------------------
-	 * Run one component test. Related befores and afters are run in their
-	 * respected positions of the test.
-	 * @param testCase - The test case which will be run
-	 */
-	void Test::runTest(std::shared_ptr<TestCase> testCase) {
-		// Process before functions. These are removed
-		// after one use.
-		for(auto f : testCase->beforeList) {
-			f();
-		}
+		it(description, Resources(std::vector<std::string>(), cores), [=]() -> bool {
+			FuzzTarget fixture = [target](const uint8_t* data, size_t size) -> bool {
+				for(auto& hook : beforeEachList) {
+					hook();
+				}
 
-		// Process beforeEach list. These are not removed
-		// after one use.
-		for(auto f : beforeEachList) {
-			f();
-		}
+				bool passed = target(data, size);
 
-		bool passed = testCase->test();
+				for(auto& hook : afterEachList) {
+					hook();
+				}
 
-		// Process after functions. These are removed
-		// after one use.
-		for(auto f : testCase->afterList) {
-			f();
-		}
+				return passed;
+			};
 
-		// Process afterEach list. These are not removed
-		// after one use.
-		for(auto f : afterEachList) {
-			f();
-		}
-		
-		// Guard Test::testsRun and
-		// Test::testsFailed
-		std::lock_guard<std::mutex> g_stdout(testCountMutex);
+			// Each fuzz test keeps its own corpus, named after it.
+			std::string corpus;
 
-		testsRun++;
+			if(!fuzzCorpus.empty()) {
+				corpus = description;
+				std::replace_if(corpus.begin(), corpus.end(), [](char c) { return !std::isalnum(static_cast<unsigned char>(c)); }, '-');
+				File::makeDirectory(fuzzCorpus);
+				corpus = fuzzCorpus + "/" + corpus;
+			}
 
-		if(passed) {
-			Print::fragment(TAB + "PASS ", GREEN);
-		} else {
-			Print::fragment(TAB + "FAIL ", RED);
-			testsFailed++;
-		}
+			FuzzReport report = FuzzReport();
+			int workers = beforeEachList.empty() && afterEachList.empty() ? cores : 1;
+
+			unpinned([&]() {
+				report = Fuzz::run(fixture, workers, fuzzRuns, corpus);
+			});
+			std::ostringstream summary;
+
+			summary << FUZZ_OUTPUT << report.runs << " runs, " << report.corpus << " inputs in corpus, "
+					<< report.features << " features, " << workers << (workers == 1 ? " worker" : " workers");
+			Print::line(summary.str(), GREY);
+
+			if(!report.instrumented && report.runs > 0) {
+				Print::line(std::string(FUZZ_OUTPUT) + "no coverage instrumentation found, inputs were mutated blindly", GREY);
+			}
+
+			if(report.crashSignal != 0) {
+				Print::line(FUZZ_OUTPUT + std::string("target crashed with signal ") + std::to_string(report.crashSignal) + " (" + strsignal(report.crashSignal) + ")", GREY);
+			}
+
+			if(report.exitCode != 0) {
+				Print::line(FUZZ_OUTPUT + std::string("target exited with code ") + std::to_string(report.exitCode), GREY);
+			}
+
+			if(report.inputLost) {
+				Print::line(FUZZ_OUTPUT + std::string("the failing input was lost"), GREY);
+			} else if(report.failed) {
+				std::ostringstream failure;
+
+				failure << FUZZ_OUTPUT << "failing input (" << report.failure.size() << " bytes, minimised from "
+						<< report.originalLength << ")" << std::hex << std::setfill('0');
+
+				for(size_t i = 0; i < report.failure.size() && i < 64; i++) {
+					failure << " " << std::setw(2) << static_cast<int>(static_cast<uint8_t>(report.failure[i]));
+				}
+
+				Print::line(failure.str(), GREY);
 
-		std::cout << testCase->description << std::endl;
+				if(!report.failurePath.empty()) {
+					Print::line(FUZZ_OUTPUT + std::string("saved to ") + report.failurePath, GREY);
+				}
+			}
+
+			return !report.failed;
+		});
 	}
 
 	/**
-	 * Test::runTests
+	 * Test::generate
 	 * -------------------
-	 * Run all the tests added to the test list with
-	 * the Test::it function.
+	 * Describe a suite whose tests are produced one at a time by a
+	 * generator, as workers become free, rather than all being added
+	 * up front. Only the tests being run are held in memory, so a
+	 * suite can be generated from a very large corpus. Before-each and
+	 * after-each functions run around every generated test; before and
+	 * after functions run around the first one, as for Test::it.
+	 * @param description - Describes the set of tests to be run
+	 * @param generator - Fills in the next test and returns true, or
+	 *				returns false once there are none left. Never called
+	 *				by two workers at once.
 	 */
-	void Test::runTests() {
+	void Test::generate(std::string description, std::function<bool(GeneratedTest&)> generator) {
+		std::string outer = currentSuite;
+		GeneratedTest generated;
+
+		// A test without a description carries the suite, resources and
+		// the cache key's hash for the tests generated from it.
+		currentSuite = description;
+		TestCase source = makeTest("", nullptr);
+		currentSuite = outer;
+		beforeList.clear();
+		afterList.clear();
+
 		if(runAsync) {
-			std::vector<std::shared_ptr<std::thread>> taskList;
-			std::shared_ptr<TestCase> testPtr;
-			int i = 0;
-			auto waitOnThreads = [](std::vector<std::shared_ptr<std::thread>>* tl) {
-				// Wait for all remaining tasks to complete. The thread
-				// shared_ptr will delete itself after it goes
-				// out of scope.
-				if(tl != nullptr) {
-					for(auto task : *tl) {
-						task->join();
-					}
+			source.generate = generator;
+			testList.push_back(source);
+			return;
+		}
 
-					// Clear the task list, as all threads
-					// it contains have terminated.
-					tl->clear();
-				}
-			};
+		Print::line("# " + description);
+		bool claimed = false;
 
-			for(auto test : testList) {
-				// Only run one suite at a time - even concurrently
-				if(i == maxThreads || test.suite != currentSuite) {				
-					waitOnThreads(&taskList);
-					i = 0;
-
-					// If the suite has changed, print out the new
-					// suite name before running the next suite of tests
-					if(test.suite != currentSuite) {
-						Print::line("# " + test.suite);
-						currentSuite = test.suite;
-					}
-				}
+		while(generator(generated)) {
+			TestCase test = fromGenerated(source, generated);
 
-				testPtr = std::make_shared<TestCase>(test);
-				taskList.push_back(std::make_shared<std::thread>(runTest, testPtr));
-				i++;
+			// The befores and afters go with the first test to run.
+			if(!claimed && selected(test)) {
+				test.beforeList = source.beforeList;
+				test.afterList = source.afterList;
+				claimed = true;
 			}
 
-			waitOnThreads(&taskList);
-		}
-		
-		// print out the pending tests
-		Print::line("@ Pending Tests");
-
-		for(auto task : pendingTest) {
-			Print::line(TAB + "(" + task.suite + ") " + task.description);
+			addTest(test);
 		}
 	}
 
 	/**
-	 * Test::beforeEach
+	 * Test::fromGenerated
 	 * -------------------
-	 * Add a function to the stack which will run before
-	 * each test.
-	 * @param lambda - The function which will be run before each
-	 * 					'it' test is executed.
+	 * Make a generated test into a test case of its suite, without
+	 * the suite's befores and afters.
+	 * @param source - The suite's generator entry
+	 * @param generated - The generated test
 	 */
-	void Test::beforeEach(std::function<void()> lambda) {
-		beforeEachList.push_back(lambda);
+	TestCase Test::fromGenerated(const TestCase& source, const GeneratedTest& generated) {
+		TestCase test = source;
+
+		test.generate = nullptr;
+		test.beforeList.clear();
+		test.afterList.clear();
+		test.description = generated.description;
+		test.test = generated.test;
+
+		if(source.resultKey != 0) {
+			test.resultKey = File::hash(generated.description.c_str(), generated.description.size(), source.resultKey);
+			test.resultKey = test.resultKey == 0 ? 1 : test.resultKey;
+		}
+
+		return test;
 	}
 
 	/**
-	 * Test::before
+	 * Test::selected
 	 * -------------------
-	 * Add a function to the stack which will run before
-	 * the 'it' test immediately following this function.
-	 * The function will not execute again unless Test::before
-	 * is called again.
-	 * @param lambda - The function which will be run before the next 'it' test.
+	 * Returns whether a test passes the filter and belongs to this shard.
+	 * @param test - The test case to check
 	 */
-	void Test::before(std::function<void()> lambda) {
-		beforeList.push_back(lambda);
+	bool Test::selected(const TestCase& test) {
+		if(!filter.empty() && (test.suite + " " + test.description).find(filter) == std::string::npos) {
+			return false;
+		}
+
+		if(shardCount <= 1) {
+			return true;
+		}
+
+		uint64_t hash = File::hash(test.suite.c_str(), test.suite.size() + 1);
+		hash = File::hash(test.description.c_str(), test.description.size(), hash);
+		return static_cast<int>(hash % static_cast<uint64_t>(shardCount)) == shardIndex;
 	}
 
 	/**
-	 * Test::afterEach
+	 * Test::placement
 	 * -------------------
-	 * Add a function to the stack which will run after
-	 * each test.
-	 * @param lambda - The function which will be run after each
-	 * 					'it' test is executed.
+	 * Returns the CPUs workers are placed on, in the order workers
+	 * are pinned to them. The last CPU is the one reserved for
+	 * benchmarks.
 	 */
-	void Test::afterEach(std::function<void()> lambda) {
-		afterEachList.push_back(lambda);
+	std::vector<int> Test::placement() {
+		std::vector<int> cpus = cpuSet.empty() ? Affinity::available() : cpuSet;
+		return numaSpread ? Affinity::spread(cpus) : cpus;
 	}
 
 	/**
-	 * Test::after
+	 * Test::unpinned
 	 * -------------------
-	 * Add a function to the stack which will run after
-	 * the 'it' test immediately following this function.
-	 * The function will not execute again unless Test::before
-	 * is called again.
-	 * @param lambda - The function which will be run after the next 'it' test.
+	 * Run body with the calling worker allowed on every CPU workers
+	 * are placed on, so that threads it starts (which inherit its
+	 * mask) are not confined to the worker's own CPU.
+	 * @param body - The function to run
 	 */
-	void Test::after(std::function<void()> lambda) {
-		afterList.push_back(lambda);
+	void Test::unpinned(const std::function<void()>& body) {
+		std::vector<int> affinity = Affinity::current();
+		bool widened = Affinity::pin(placement());
+
+		body();
+
+		if(widened && !affinity.empty()) {
+			Affinity::pin(affinity);
+		}
 	}
 
 	/**
-	 * Test::printSummary
+	 * Test::threadBudget
 	 * -------------------
-	 * Print a summary of all the tests that
-	 * have been run.
+	 * Returns the number of threads a suite may use, or a number
+	 * less than zero if there is no limit. EARL_MAX_THREADS caps
+	 * whatever Test::setMaxConcurrency asked for.
 	 */
-	void Test::printSummary() {
-		std::cout << std::endl;
-		std::cout << "Summary: " << std::endl;
-		std::cout << "---------------" << std::endl;
-		std::cout << testsRun << " tests run, " << (testsRun - testsFailed) << " tests passed. (" << getTestsPending() << " tests pending.)" << std::endl;
+	int Test::threadBudget() {
+		if(threadLimit <= 0) {
+			return maxThreads;
+		}
+
+		return maxThreads >= 0 ? std::min(std::max(maxThreads, 1), threadLimit) : threadLimit;
 	}
 
 	/**
-	 * Test::setMaxConcurrency
+	 * Test::cores
 	 * -------------------
-	 * Affects the number of threads that can be
-	 * launched in asynchronous mode. Setting threadCount
-	 * to a number less than zero means there is no limit
-	 * to the number of threads that can be launched.
-	 * @param threadCount - The maximum number of threads to use
-	 *						whilst running tests.
+	 * Returns the hardware concurrency, capped by EARL_MAX_THREADS.
 	 */
-	void Test::setMaxConcurrency(int threadCount) {
-		maxThreads = threadCount;
+	int Test::cores() {
+		int count = std::max(static_cast<int>(std::thread::hardware_concurrency()), 1);
+		return threadLimit > 0 ? std::min(count, threadLimit) : count;
+	}
+
+	void Test::it(std::string description) {
+#ifdef _MSC_VER
+		PendingTestCase test;
+		test.description = description;
+		test.suite = suite;
+#else
+		PendingTestCase test { description, currentSuite };
+#endif
+		pendingTest.push_back(test);
+		Metrics::setPending(pendingTest.size());
+	}
+	
+	/**
+	 * Test::runAsynchronously
+	 * -------------------
+	 * Tell Earl to whether to run tests in an asynchronous manner.
+	 * @param async - Set to true to run tests asynchronously.
+	 */
+	void Test::runAsynchronously(bool async) {
+		runAsync = async;
+	}
+
+	/**
+	 * runHooks
+	 * -------------------
+	 * Run a list of befores or afters, tracing them as one span.
+	 */
+	static void runHooks(const std::vector<std::function<void()>>& hooks, const char* name, size_t worker) {
+		if(hooks.empty()) {
+			return;
+		}
+
+		uint64_t begin = Trace::enabled() ? Trace::now() : 0;
+
+		for(auto f : hooks) {
+			f();
+		}
+
+		if(Trace::enabled()) {
+			Trace::record(worker, "hook", name, begin, Trace::now());
+		}
+	}
+
+	/**
+	 * Test::runTest
+	 * -------------------
+	 * Run one component test. Related befores and afters are run in their
+	 * respected positions of the test.
+	 * @param testCase - The test case which will be run
+	 * @param worker - The index of the worker running the test
+	 */
+	void Test::runTest(const TestCase& testCase, size_t worker) {
+		TestResult result = { testCase.resultKey, testCase.cacheScope, 0, 0, false, false, false, "" };
+
+		if(Metrics::enabled()) {
+			Metrics::begin(worker, testCase.suite, testCase.description);
+		}
+
+		auto started = std::chrono::steady_clock::now();
+		ResourceUsage usage = { 0, 0, 0, 0, 0 }, startUsage = usage;
+
+		// Isolated tests are measured by their child processes.
+		if(trackUsage && !isolated) {
+			Usage::begin(!runAsync);
+			startUsage = Usage::thread();
+		}
+
+		// Retry a failing test, running only this test again.
+		do {
+			result.passed = isolated ? attemptIsolated(testCase, worker, usage) : attemptTest(testCase, worker);
+			result.attempts++;
+		} while(!result.passed && result.attempts <= maxRetries);
+
+		if(trackUsage && !isolated) {
+			usage = Usage::since(startUsage);
+			Usage::end();
+		}
+
+		result.flaky = result.passed && result.attempts > 1;
+
+		if(Metrics::enabled()) {
+			Metrics::end(worker, result.passed, result.flaky);
+		}
+
+		testsRun++;
+
+		if(result.flaky) {
+			testsFlaky++;
+		} else if(!result.passed) {
+			testsFailed++;
+		}
+
+		if(!statsFile.empty()) {
+			result.statsKey = File::hash(testCase.suite.c_str(), testCase.suite.size() + 1);
+			result.statsKey = File::hash(testCase.description.c_str(), testCase.description.size(), result.statsKey);
+			result.name = testCase.suite + ": " + testCase.description;
+		}
+
+		std::ostringstream line;
+		line << testCase.description;
+
+		if(result.attempts > 1) {
+			line << " (" << result.attempts << " attempts";
+
+			if(!statsFile.empty()) {
+				// The statistics are only written to while merging, so
+				// they can be read while tests are running.
+				auto stats = testStats.find(result.statsKey);
+				int attempts = result.attempts + (stats != testStats.end() ? stats->second.attempts : 0);
+				int passes = (result.passed ? 1 : 0) + (stats != testStats.end() ? stats->second.passes : 0);
+
+				line << ", " << (100 * passes / attempts) << "% of " << attempts << " attempts passed over all runs";
+			}
+
+			line << ")";
+		}
+
+		if(testCase.benchmark) {
+			std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - started;
+			line << " (" << std::fixed << std::setprecision(3) << elapsed.count() << " ms)";
+		}
+
+		if(trackUsage) {
+			line << " (" << Usage::format(usage) << ")";
+		}
+
+		if(result.flaky) {
+			Print::status(TAB + "FLAKY ", YELLOW, line.str());
+		} else if(result.passed) {
+			Print::status(TAB + "PASS ", GREEN, line.str());
+		} else {
+			Print::status(TAB + "FAIL ", RED, line.str());
+		}
+
+		// Results are only kept for the cache and statistics, so that
+		// memory does not grow with the number of tests run.
+		if(result.resultKey != 0 || !statsFile.empty()) {
+			resultSlabs[worker].results.push_back(result);
+		}
+	}
+
+	/**
+	 * Test::attemptTest
+	 * -------------------
+	 * Run a test once, along with its befores and afters.
+	 * @param testCase - The test case which will be run
+	 * @param worker - The index of the worker running the test
+	 * @return Whether the test passed.
+	 */
+	bool Test::attemptTest(const TestCase& testCase, size_t worker) {
+		// Process before functions. These are removed
+		// after one use.
+		runHooks(testCase.beforeList, "before", worker);
+
+		// Process beforeEach list. These are not removed
+		// after one use.
+		runHooks(beforeEachList, "beforeEach", worker);
+
+		uint64_t begin = Trace::enabled() ? Trace::now() : 0;
+		bool passed = testCase.test();
+
+		if(Trace::enabled()) {
+			Trace::record(worker, "test", testCase.description, begin, Trace::now());
+		}
+
+		// Process after functions. These are removed
+		// after one use.
+		runHooks(testCase.afterList, "after", worker);
+
+		// Process afterEach list. These are not removed
+		// after one use.
+		runHooks(afterEachList, "afterEach", worker);
+
+		return passed;
+	}
+
+	/**
+	 * Test::attemptIsolated
+	 * -------------------
+	 * Run a test once in a child process, along with its befores and
+	 * afters, adding the child's resource usage to usage. A child
+	 * which crashes fails the test.
+	 * @param testCase - The test case which will be run
+	 * @param worker - The index of the worker running the test
+	 * @param usage - Accumulates the resource usage of each attempt
+	 * @return Whether the test passed.
+	 */
+	bool Test::attemptIsolated(const TestCase& testCase, size_t worker, ResourceUsage& usage) {
+#ifdef _WIN32
+		return attemptTest(testCase, worker);
+#else
+		int growthPipe[2];
+		pid_t child;
+		// The child's events are lost with it, so the parent records
+		// the attempt (hooks included) on the worker's timeline.
+		uint64_t begin = Trace::enabled() ? Trace::now() : 0;
+
+		if(pipe(growthPipe) != 0) {
+			return attemptTest(testCase, worker);
+		}
+
+		// Only the forking thread survives in the child, so fork while
+		// holding stdout to be sure no other worker is left owning it.
+		{
+			std::unique_lock<std::mutex> output = Print::hold();
+			child = fork();
+		}
+
+		if(child == 0) {
+			close(growthPipe[0]);
+			Usage::begin(true);
+
+			bool passed = attemptTest(testCase, worker);
+			long growth = Usage::peakGrowth();
+
+			std::cout.flush();
+			ssize_t written = write(growthPipe[1], &growth, sizeof(growth));
+			_exit(passed && written == sizeof(growth) ? 0 : 1);
+		}
+
+		close(growthPipe[1]);
+
+		if(child < 0) {
+			close(growthPipe[0]);
+			return attemptTest(testCase, worker);
+		}
+
+		long growth = 0;
+		int status = 0;
+		struct rusage childUsage;
+
+		if(read(growthPipe[0], &growth, sizeof(growth)) != sizeof(growth)) {
+			growth = 0;
+		}
+
+		close(growthPipe[0]);
+
+		while(wait4(child, &status, 0, &childUsage) < 0) {
+			if(errno != EINTR) {
+				return false;
+			}
+		}
+
+		if(Trace::enabled()) {
+			Trace::record(worker, "test", testCase.description, begin, Trace::now());
+		}
+
+		usage.minorFaults += childUsage.ru_minflt;
+		usage.majorFaults += childUsage.ru_majflt;
+		usage.voluntarySwitches += childUsage.ru_nvcsw;
+		usage.involuntarySwitches += childUsage.ru_nivcsw;
+		usage.peakGrowth = std::max(usage.peakGrowth, growth);
+
+		if(WIFSIGNALED(status)) {
+			Print::line(TAB + testCase.description + " crashed with signal " + std::to_string(WTERMSIG(status)) + " (" + strsignal(WTERMSIG(status)) + ")", RED);
+		}
+
+		return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+#endif
+	}
+
+	/**
+	 * Test::skipCached
+	 * -------------------
+	 * Report a test as cached if it passed in the previous run
+	 * against the same cache key.
+	 * @param testCase - The test case which is about to be run
+	 * @param worker - The index of the worker running the test
+	 * @return Whether the test was skipped.
+	 */
+	bool Test::skipCached(const TestCase& testCase, size_t worker) {
+		if(fullRun || testCase.resultKey == 0 || cachedResults.count(testCase.resultKey) == 0) {
+			return false;
+		}
+
+		TestResult result = { testCase.resultKey, testCase.cacheScope, 0, 0, true, false, true, "" };
+
+		testsCached++;
+		resultSlabs[worker].results.push_back(result);
+
+		if(Metrics::enabled()) {
+			Metrics::skip();
+		}
+		Print::status(TAB + "CACHED ", GREY, testCase.description);
+		return true;
+	}
+
+	/**
+	 * Test::runSuite
+	 * -------------------
+	 * Run the tests in testList[begin, end) on a pool of workers,
+	 * returning once they have all finished.
+	 * @param begin - Index of the suite's first test
+	 * @param end - Index one past the suite's last test
+	 */
+	void Test::runSuite(size_t begin, size_t end) {
+		std::vector<size_t> tests, benchmarks;
+		std::vector<std::thread> pool;
+		uint64_t suiteBegin = Trace::enabled() ? Trace::now() : 0;
+
+		for(size_t i = begin; i < end; i++) {
+			(testList[i].benchmark ? benchmarks : tests).push_back(i);
+		}
+
+		size_t workers = tests.size();
+		std::atomic<size_t> next(0);
+		ResourceQueue resources;
+		bool constrained = false;
+		int limit = threadBudget();
+
+		if(limit >= 0) {
+			workers = std::min(workers, static_cast<size_t>(limit));
+		}
+
+		// Only suites which declare resources go through the resource
+		// queue; the rest hand out tests with a single atomic increment.
+		for(size_t i = begin; i < end; i++) {
+			constrained |= !testList[i].resources.locks.empty() || testList[i].resources.weight > 1;
+		}
+
+		resources.weight = 0;
+		resources.budget = limit >= 0 ? limit : std::numeric_limits<int>::max();
+
+		// A generated suite's tests all need the same resources, so
+		// they are packed by limiting the number of workers.
+		const TestCase& source = testList[begin];
+		std::mutex generatorMutex;
+		bool generating = static_cast<bool>(source.generate), exhausted = false;
+		// Whether a worker has taken the suite's befores and afters.
+		std::atomic<bool> claimed(source.beforeList.empty() && source.afterList.empty());
+
+		if(generating) {
+			int budget = limit >= 0 ? limit : cores();
+			workers = source.resources.locks.empty() ? std::max(budget / std::max(source.resources.weight, 1), 1) : 1;
+			constrained = false;
+
+			if(Metrics::enabled()) {
+				Metrics::dequeue();
+			}
+		}
+
+		// Benchmarks run one after another on a worker of their own,
+		// after the pool's workers.
+		size_t threads = workers + (benchmarks.empty() ? 0 : 1);
+
+		// Each worker records into its own slab, so the slabs must
+		// all exist before any worker starts.
+		if(resultSlabs.size() < threads) {
+			resultSlabs.resize(threads);
+		}
+
+		Trace::prepare(threads);
+		std::vector<uint64_t> finished(threads);
+
+		if(Metrics::enabled()) {
+			Metrics::prepare(threads);
+		}
+
+		// Reserve the last CPU for benchmarks when there is another to
+		// run the rest of the suite on. Workers are only pinned to a CPU
+		// each when asked to be; otherwise they float across the rest.
+		// Under EARL_MAX_THREADS the machine is shared with other
+		// processes, so no CPU is reserved and benchmarks instead wait
+		// for the suite's other tests to finish.
+		std::vector<int> cpus = placement();
+		bool pinEach = !cpuSet.empty() || numaSpread;
+		bool sharing = threadLimit > 0;
+		int reserved = -1;
+		std::mutex poolMutex;
+		std::condition_variable poolFinished;
+		size_t active = workers;
+
+		if(!benchmarks.empty() && cpus.size() > 1 && !sharing) {
+			reserved = cpus.back();
+			cpus.pop_back();
+		}
+
+		for(size_t worker = 0; worker < threads; worker++) {
+			pool.push_back(std::thread([&, worker]() {
+				bool benchmarking = worker == workers;
+				const std::vector<size_t>& queue = benchmarking ? benchmarks : tests;
+				size_t position = 0;
+				TestCase blank, generated;
+
+				if(generating) {
+					blank = source;
+					blank.generate = nullptr;
+					blank.beforeList.clear();
+					blank.afterList.clear();
+				}
+
+				if(benchmarking) {
+					if(sharing) {
+						std::unique_lock<std::mutex> lock(poolMutex);
+						poolFinished.wait(lock, [&]() { return active == 0; });
+					}
+
+					if(reserved >= 0) {
+						Affinity::pin(std::vector<int>(1, reserved));
+					}
+				} else if(pinEach && !cpus.empty()) {
+					Affinity::pin(std::vector<int>(1, cpus[worker % cpus.size()]));
+				} else if(reserved >= 0) {
+					Affinity::pin(cpus);
+				}
+
+				while(true) {
+					const TestCase* test = nullptr;
+
+					if(generating) {
+						// Generate tests until one is selected to run.
+						GeneratedTest produced;
+
+						while(test == nullptr) {
+							{
+								std::lock_guard<std::mutex> lock(generatorMutex);
+								exhausted = exhausted || !source.generate(produced);
+
+								if(exhausted) {
+									break;
+								}
+							}
+
+							generated = fromGenerated(blank, produced);
+							test = selected(generated) ? &generated : nullptr;
+
+							// The befores and afters go with the first test to run.
+							if(test != nullptr && !claimed) {
+								std::lock_guard<std::mutex> lock(generatorMutex);
+
+								if(!claimed) {
+									generated.beforeList = source.beforeList;
+									generated.afterList = source.afterList;
+									claimed = true;
+								}
+							}
+						}
+					} else {
+						size_t i;
+
+						if(constrained) {
+							// Benchmarks have a core to themselves, so only
+							// their locks are taken.
+							i = acquireTest(resources, benchmarking ? benchmarks : tests, !benchmarking);
+						} else {
+							i = benchmarking ? position++ : next++;
+							i = i < queue.size() ? queue[i] : npos;
+						}
+
+						test = i != npos ? &testList[i] : nullptr;
+
+						if(test != nullptr && Metrics::enabled()) {
+							Metrics::dequeue();
+						}
+					}
+
+					if(test == nullptr) {
+						break;
+					}
+
+					if(!skipCached(*test, worker)) {
+						runTest(*test, worker);
+					}
+
+					if(constrained) {
+						releaseTest(resources, *test, !benchmarking);
+					}
+				}
+
+				if(!benchmarking) {
+					std::lock_guard<std::mutex> lock(poolMutex);
+
+					if(--active == 0) {
+						poolFinished.notify_all();
+					}
+				}
+
+				finished[worker] = Trace::enabled() ? Trace::now() : 0;
+			}));
+		}
+
+		for(auto& thread : pool) {
+			thread.join();
+		}
+
+		// Trace the time each worker spent waiting for the rest of
+		// the suite to finish.
+		if(Trace::enabled()) {
+			uint64_t suiteEnd = Trace::now();
+
+			for(size_t worker = 0; worker < threads; worker++) {
+				Trace::record(worker, "barrier", "suite barrier", finished[worker], suiteEnd);
+			}
+
+			Trace::record(Trace::runner, "suite", testList[begin].suite, suiteBegin, suiteEnd);
+		}
+	}
+
+	/**
+	 * Test::acquireTest
+	 * -------------------
+	 * Wait until one of the waiting tests can run without exceeding
+	 * the weight budget or sharing a lock, then take its resources.
+	 * A test heavier than the whole budget runs on its own.
+	 * @param resources - The suite's resources
+	 * @param waiting - Indices of the tests yet to start; the chosen
+	 *				test is removed.
+	 * @param weighed - Whether the test's weight counts against the budget
+	 * @return The chosen test's index, or npos once none are waiting.
+	 */
+	size_t Test::acquireTest(ResourceQueue& resources, std::vector<size_t>& waiting, bool weighed) {
+		std::unique_lock<std::mutex> lock(resources.mutex);
+
+		while(!waiting.empty()) {
+			// Take the first test which fits, so that lighter tests fill
+			// the gaps left by heavier ones.
+			for(auto candidate = waiting.begin(); candidate != waiting.end(); candidate++) {
+				const Resources& needs = testList[*candidate].resources;
+				int weight = weighed ? std::max(needs.weight, 1) : 0;
+				bool fits = resources.weight == 0 || resources.weight + weight <= resources.budget;
+
+				for(auto& name : needs.locks) {
+					fits &= resources.held.count(name) == 0;
+				}
+
+				if(fits) {
+					size_t index = *candidate;
+
+					waiting.erase(candidate);
+					resources.weight += weight;
+					resources.held.insert(needs.locks.begin(), needs.locks.end());
+					return index;
+				}
+			}
+
+			resources.released.wait(lock);
+		}
+
+		return npos;
+	}
+
+	/**
+	 * Test::releaseTest
+	 * -------------------
+	 * Give back the resources taken by Test::acquireTest.
+	 * @param resources - The suite's resources
+	 * @param testCase - The test which finished
+	 * @param weighed - Whether the test's weight counted against the budget
+	 */
+	void Test::releaseTest(ResourceQueue& resources, const TestCase& testCase, bool weighed) {
+		{
+			std::lock_guard<std::mutex> lock(resources.mutex);
+
+			resources.weight -= weighed ? std::max(testCase.resources.weight, 1) : 0;
+
+			for(auto& name : testCase.resources.locks) {
+				resources.held.erase(name);
+			}
+		}
+
+		resources.released.notify_all();
+	}
+
+	/**
+	 * Test::runTests
+	 * -------------------
+	 * Run all the tests added to the test list with
+	 * the Test::it function.
+	 */
+	void Test::runTests() {
+		if(runAsync) {
+			size_t begin = 0;
+
+			if(Metrics::enabled()) {
+				Metrics::enqueue(testList.size());
+			}
+
+			// Only run one suite at a time - even concurrently
+			while(begin < testList.size()) {
+				size_t end = begin;
+
+				// Generated suites run on their own.
+				do {
+					end++;
+				} while(end < testList.size() && testList[end].suite == testList[begin].suite &&
+						!testList[begin].generate && !testList[end].generate);
+
+				// Print out the suite name before running
+				// the suite of tests
+				currentSuite = testList[begin].suite;
+				Print::line("# " + currentSuite);
+
+				runSuite(begin, end);
+				begin = end;
+			}
+		}
+		
+		// print out the pending tests
+		Print::line("@ Pending Tests");
+
+		for(auto task : pendingTest) {
+			Print::line(TAB + "(" + task.suite + ") " + task.description);
+		}
+
+		mergeResults();
+		writeResultCache();
+		writeStats();
+		writeReport();
+
+		if(!traceFile.empty()) {
+			Trace::write(traceFile);
+		}
+
+		Metrics::flush();
+	}
+
+	/**
+	 * Test::setMetricsFile
+	 * -------------------
+	 * Write live metrics of the run (tests completed, failed and
+	 * queued, in-flight tests, throughput and worker utilisation) to
+	 * a file in the Prometheus text format, refreshed every interval.
+	 * @param path - The metrics file, or an empty string to stop writing metrics.
+	 * @param interval - Milliseconds between refreshes.
+	 */
+	void Test::setMetricsFile(std::string path, int interval) {
+		if(path.empty()) {
+			Metrics::flush();
+			Metrics::stop();
+		} else {
+			Metrics::start(path, interval);
+		}
+	}
+
+	/**
+	 * Test::setTraceFile
+	 * -------------------
+	 * Record when each worker runs each test, hook and suite barrier,
+	 * and write it to a Chrome trace-event JSON file at the end of
+	 * Test::runTests. Tracing is off by default.
+	 * @param path - The trace file, or an empty string to turn tracing off.
+	 */
+	void Test::setTraceFile(std::string path) {
+		traceFile = path;
+		Trace::enable(!traceFile.empty());
+	}
+
+	/**
+	 * Test::mergeResults
+	 * -------------------
+	 * Fold the workers' result slabs into the result
+	 * cache and the stability statistics.
+	 */
+	void Test::mergeResults() {
+		for(auto& slab : resultSlabs) {
+			for(auto& result : slab.results) {
+				// Flaky tests are never cached as passing.
+				if(result.resultKey != 0 && (result.cached || (result.passed && !result.flaky))) {
+					passedResults[result.resultKey] = result.cacheScope;
+				} else if(result.resultKey != 0) {
+					failedResults.insert(result.resultKey);
+				}
+
+				if(!statsFile.empty() && !result.cached) {
+					TestStats& stats = testStats[result.statsKey];
+					stats.attempts += result.attempts;
+					stats.passes += result.passed ? 1 : 0;
+					stats.flakyRuns += result.flaky ? 1 : 0;
+					stats.name = result.name;
+				}
+			}
+
+			slab.results.clear();
+		}
+	}
+
+	/**
+	 * Test::useResultCache
+	 * -------------------
+	 * Cache the results of passing tests in a file, and skip tests
+	 * which passed in the previous run against the same cache key.
+	 * Caching is off by default.
+	 * @param path - The cache file, or an empty string to turn caching off.
+	 */
+	void Test::useResultCache(std::string path) {
+		cacheFile = path;
+		cachedResults.clear();
+		cacheScopes.clear();
+
+		if(cacheFile.empty()) {
+			return;
+		}
+
+		// Suites without their own key are keyed on the test binary,
+		// so that rebuilding it invalidates their results. Entries are
+		// owned by the binary's path, which stays the same across builds.
+		if(binaryCacheKey.empty()) {
+			std::string path = File::executablePath();
+			MappedFile binary(path);
+
+			cacheOwner = File::hash(path.c_str(), path.size());
+
+			if(binary.isOpen()) {
+				std::ostringstream key;
+				key << std::hex << File::hash(binary.data(), binary.size());
+				binaryCacheKey = key.str();
+			}
+		}
+
+		MappedFile cache(cacheFile);
+		std::string header = CACHE_HEADER "\n";
+
+		if(!cache.isOpen() || cache.size() < header.size() ||
+			std::memcmp(cache.data(), header.c_str(), header.size()) != 0) {
+			return;
+		}
+
+		std::istringstream lines(std::string(reinterpret_cast<const char*>(cache.data()) + header.size(), cache.size() - header.size()));
+		std::string line;
+
+		// Each line holds an entry's owner, scope and key.
+		while(std::getline(lines, line)) {
+			char* end;
+			CachedResult entry;
+			entry.owner = std::strtoull(line.c_str(), &end, 16);
+			entry.scope = std::strtoull(end, &end, 16);
+			uint64_t key = std::strtoull(end, nullptr, 16);
+
+			if(key != 0) {
+				cachedResults[key] = entry;
+			}
+		}
+	}
+
+	/**
+	 * Test::forceFullRun
+	 * -------------------
+	 * Run every test even if its result is cached. The cache
+	 * is still updated. Defaults to true when the EARL_FULL_RUN
+	 * environment variable is set to anything but 0.
+	 * @param force - Set to true to ignore cached results.
+	 */
+	void Test::forceFullRun(bool force) {
+		fullRun = force;
+	}
+
+	/**
+	 * Test::setRetries
+	 * -------------------
+	 * Retry failing tests up to retryCount times. A test which
+	 * passes on a retry is reported as flaky rather than failed.
+	 * Retries run on the same worker as the failed attempt.
+	 * @param retryCount - The number of retries (defaults to none).
+	 */
+	void Test::setRetries(int retryCount) {
+		maxRetries = retryCount > 0 ? retryCount : 0;
+	}
+
+	/**
+	 * Test::useStatsFile
+	 * -------------------
+	 * Keep the number of attempts, passes and flaky runs of every
+	 * test in a file, across retries and across runs, and print a
+	 * flaky test's pass rate alongside it.
+	 * @param path - The statistics file, or an empty string to stop
+	 *				keeping statistics.
+	 */
+	void Test::useStatsFile(std::string path) {
+		statsFile = path;
+		testStats.clear();
+
+		if(statsFile.empty()) {
+			return;
+		}
+
+		MappedFile stats(statsFile);
+		std::string header = STATS_HEADER "\n";
+
+		if(!stats.isOpen() || stats.size() < header.size() ||
+			std::memcmp(stats.data(), header.c_str(), header.size()) != 0) {
+			return;
+		}
+
+		std::istringstream lines(std::string(reinterpret_cast<const char*>(stats.data()) + header.size(), stats.size() - header.size()));
+		std::string line;
+
+		// Each line holds the key, attempts, passes, flaky runs and name.
+		while(std::getline(lines, line)) {
+			std::istringstream fields(line);
+			uint64_t key;
+			TestStats entry;
+
+			if(fields >> std::hex >> key >> std::dec >> entry.attempts >> entry.passes >> entry.flakyRuns) {
+				std::getline(fields >> std::ws, entry.name);
+				testStats[key] = entry;
+			}
+		}
+	}
+
+	/**
+	 * Test::writeStats
+	 * -------------------
+	 * Replace the statistics file with the updated statistics.
+	 */
+	void Test::writeStats() {
+		std::ostringstream stats;
+
+		if(statsFile.empty()) {
+			return;
+		}
+
+		stats << STATS_HEADER << "\n";
+
+		for(auto entry : testStats) {
+			std::string name = entry.second.name;
+			std::replace(name.begin(), name.end(), '\n', ' ');
+
+			stats << std::hex << std::setfill('0') << std::setw(16) << entry.first << std::dec << " "
+				  << entry.second.attempts << " " << entry.second.passes << " "
+				  << entry.second.flakyRuns << " " << name << "\n";
+		}
+
+		std::string contents = stats.str();
+		File::writeAtomically(statsFile, contents.data(), contents.size());
+	}
+
+	/**
+	 * Test::writeReport
+	 * -------------------
+	 * Append the counts of this run to the file named by
+	 * EARL_REPORT_FILE, for earl-run to merge.
+	 */
+	void Test::writeReport() {
+		std::string path = envString("EARL_REPORT_FILE");
+
+		if(path.empty()) {
+			return;
+		}
+
+		std::ofstream report(path, std::ios::app);
+		report << REPORT_HEADER << " " << testsRun << " " << getTestsPassed() << " " << getTestsFailed() << " "
+			   << getTestsPending() << " " << getTestsCached() << " " << getTestsFlaky() << "\n";
+	}
+
+	/**
+	 * Test::writeResultCache
+	 * -------------------
+	 * Merge the tests that passed in this run into the result cache,
+	 * and drop those which failed. Tests this run did not reach, e.g.
+	 * those in other batches or filtered out, keep their entries. This
+	 * binary's entries made against a cache key it no longer uses (an
+	 * earlier build, or a suite's old key) are left out of the file,
+	 * so that it does not grow with every rebuild. They stay loaded,
+	 * as a later batch may still use their key.
+	 */
+	void Test::writeResultCache() {
+		std::ostringstream cache;
+
+		if(cacheFile.empty()) {
+			return;
+		}
+
+		for(auto key : failedResults) {
+			cachedResults.erase(key);
+		}
+
+		for(auto& passed : passedResults) {
+			CachedResult entry = { cacheOwner, passed.second };
+			cachedResults[passed.first] = entry;
+		}
+
+		cache << CACHE_HEADER << "\n" << std::hex << std::setfill('0');
+
+		for(auto& entry : cachedResults) {
+			if(entry.second.owner == cacheOwner && cacheScopes.count(entry.second.scope) == 0) {
+				continue;
+			}
+
+			cache << std::setw(16) << entry.second.owner << " " << std::setw(16) << entry.second.scope
+				  << " " << std::setw(16) << entry.first << "\n";
+		}
+
+		std::string contents = cache.str();
+		File::writeAtomically(cacheFile, contents.data(), contents.size());
+	}
+
+	/**
+	 * Test::beforeEach
+	 * -------------------
+	 * Add a function to the stack which will run before
+	 * each test.
+	 * @param lambda - The function which will be run before each
+	 * 					'it' test is executed.
+	 */
+	void Test::beforeEach(std::function<void()> lambda) {
+		beforeEachList.push_back(lambda);
+	}
+
+	/**
+	 * Test::before
+	 * -------------------
+	 * Add a function to the stack which will run before
+	 * the 'it' test immediately following this function.
+	 * The function will not execute again unless Test::before
+	 * is called again.
+	 * @param lambda - The function which will be run before the next 'it' test.
+	 */
+	void Test::before(std::function<void()> lambda) {
+		beforeList.push_back(lambda);
+	}
+
+	/**
+	 * Test::afterEach
+	 * -------------------
+	 * Add a function to the stack which will run after
+	 * each test.
+	 * @param lambda - The function which will be run after each
+	 * 					'it' test is executed.
+	 */
+	void Test::afterEach(std::function<void()> lambda) {
+		afterEachList.push_back(lambda);
+	}
+
+	/**
+	 * Test::after
+	 * -------------------
+	 * Add a function to the stack which will run after
+	 * the 'it' test immediately following this function.
+	 * The function will not execute again unless Test::before
+	 * is called again.
+	 * @param lambda - The function which will be run after the next 'it' test.
+	 */
+	void Test::after(std::function<void()> lambda) {
+		afterList.push_back(lambda);
+	}
+
+	/**
+	 * Test::printSummary
+	 * -------------------
+	 * Print a summary of all the tests that
+	 * have been run.
+	 */
+	void Test::printSummary() {
+		std::cout << std::endl;
+		std::cout << "Summary: " << std::endl;
+		std::cout << "---------------" << std::endl;
+		std::cout << testsRun << " tests run, " << getTestsPassed() << " tests passed. (" << getTestsPending() << " tests pending.)" << std::endl;
+
+		if(testsCached > 0) {
+			std::cout << testsCached << " tests cached." << std::endl;
+		}
+
+		if(testsFlaky > 0) {
+			std::cout << testsFlaky << " tests flaky." << std::endl;
+		}
+	}
+
+	/**
+	 * Test::setMaxConcurrency
+	 * -------------------
+	 * Affects the number of threads that can be
+	 * launched in asynchronous mode. Setting threadCount
+	 * to a number less than zero means there is no limit
+	 * to the number of threads that can be launched. If
+	 * EARL_MAX_THREADS is set, it caps threadCount.
+	 * @param threadCount - The maximum number of threads to use
+	 *						whilst running tests.
+	 */
+	void Test::setMaxConcurrency(int threadCount) {
+		maxThreads = threadCount;
+	}
+
+	/**
+	 * Test::setFuzzCorpus
+	 * -------------------
+	 * Keep fuzzing corpora in directory/<test description>. Inputs there
+	 * seed each run, new inputs and crashes are saved there, and crashes
+	 * saved by an earlier run are replayed first.
+	 * @param directory - The corpus directory, or an empty string to
+	 *				keep corpora in memory (the default).
+	 */
+	void Test::setFuzzCorpus(std::string directory) {
+		fuzzCorpus = directory;
+	}
+
+	/**
+	 * Test::setFuzzRuns
+	 * -------------------
+	 * Set the number of inputs each fuzz test tries, over all of
+	 * its workers (defaults to DEFAULT_FUZZ_RUNS).
+	 * @param runs - The number of inputs
+	 */
+	void Test::setFuzzRuns(size_t runs) {
+		fuzzRuns = runs;
+	}
+
+	/**
+	 * Test::setFilter
+	 * -------------------
+	 * Only run the tests whose suite and description, joined by a space,
+	 * contain pattern. Defaults to the EARL_FILTER environment variable.
+	 * @param pattern - The text to look for, or an empty string to run
+	 *				every test.
+	 */
+	void Test::setFilter(std::string pattern) {
+		filter = pattern;
+	}
+
+	/**
+	 * Test::setShard
+	 * -------------------
+	 * Split the tests between several runs by a hash of their suite and
+	 * description, and only run this run's share. Defaults to the
+	 * EARL_SHARD_INDEX and EARL_TOTAL_SHARDS environment variables.
+	 * @param index - This run's shard, from zero
+	 * @param count - The number of shards, or one to run every test
+	 */
+	void Test::setShard(int index, int count) {
+		shardCount = std::max(count, 1);
+		shardIndex = index;
+	}
+
+	/**
+	 * Test::trackResourceUsage
+	 * -------------------
+	 * Measure the page faults, context switches and peak resident set
+	 * growth of each test, and print them alongside its result. Faults
+	 * and switches are counted on the test's thread. Peak growth is
+	 * exact when tests run synchronously or isolated, and otherwise
+	 * only counts growth beyond the process's previous peak. Only
+	 * supported on Linux.
+	 * @param track - Set to true to measure resource usage.
+	 */
+	void Test::trackResourceUsage(bool track) {
+		trackUsage = track;
+	}
+
+	/**
+	 * Test::isolateTests
+	 * -------------------
+	 * Run each attempt at a test in a child process of its own, so that
+	 * a crash only fails that test and its resource usage is exact.
+	 * Results written to memory by the test are lost with the child.
+	 * Not supported on Windows, where tests keep running in-process.
+	 * @param isolate - Set to true to run tests in child processes.
+	 */
+	void Test::isolateTests(bool isolate) {
+		isolated = isolate;
+	}
+
+	/**
+	 * Test::setCpuAffinity
+	 * -------------------
+	 * Pin each worker to one CPU of a set, in order, so that tests
+	 * do not migrate between cores. Only supported on Linux.
+	 * @param cpus - The CPUs to run tests on, or an empty list to let
+	 *				workers float across every available CPU.
+	 */
+	void Test::setCpuAffinity(std::vector<int> cpus) {
+		cpuSet = cpus;
+	}
+
+	/**
+	 * Test::spreadAcrossNumaNodes
+	 * -------------------
+	 * Pin each worker to one CPU, alternating between NUMA nodes so
+	 * that memory-heavy tests are spread evenly across them. Applies
+	 * to the CPUs given to Test::setCpuAffinity, or to every available
+	 * CPU. Only supported on Linux.
+	 * @param spread - Set to true to spread workers across nodes.
+	 */
+	void Test::spreadAcrossNumaNodes(bool spread) {
+		numaSpread = spread;
 	}
 }
\ No newline at end of file
@@ -29,16 +29,29 @@
  *******************************************************************************/ 
 #pragma once
 
+#include <atomic>
 #include <chrono>
+#include <condition_variable>
+#include <cstdint>
 #include <functional>
 #include <future>
 #include <memory>
 #include <mutex>
 #include <string>
 #include <iostream>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
 #include "EarlPrint.h"
+#include "EarlAffinity.h"
 #include "EarlAssert.h"
+#include "EarlFile.h"
+#include "EarlFuzz.h"
+#include "EarlMetrics.h"
+#include "EarlStress.h"
+#include "EarlTrace.h"
+#include "EarlUsage.h"
 
 #ifndef _MSC_VER
 	#define ANSI_COLORS
@@ -48,23 +61,102 @@
 	#define GREEN ""
 	#define WHITE ""
 	#define RED ""
+	#define YELLOW ""
 #else
 	#define GREEN "\e[0;32m"
 	#define WHITE "\e[0;37m"
 	#define RED "\e[0;31m"
+	#define YELLOW "\e[0;33m"
 #endif
 
 #define TAB std::string("\t")
 
 #define DEFAULT_MAX_THREADS 2
+#define DEFAULT_FUZZ_RUNS 100000
+
+// Prefixes each line Test::runTests appends to $EARL_REPORT_FILE.
+#define REPORT_HEADER "earl-report 1"
 
 namespace Earl {
 
+	// What a test needs while it runs. Tests holding the same lock never
+	// run at the same time, and the weights of the tests running at once
+	// never add up to more than the maximum concurrency.
+	struct Resources {
+		// Names of shared resources the test needs to itself, such as
+		// "port:8080" or "tmp/cache".
+		std::vector<std::string> locks;
+		// The number of threads the test keeps busy.
+		int weight;
+
+		Resources() : weight(1) {}
+		Resources(std::vector<std::string> locks, int weight = 1) : locks(locks), weight(weight) {}
+	};
+
+	// One test produced on demand by a generator passed to Test::generate.
+	struct GeneratedTest {
+		std::string description;
+		std::function<bool()> test;
+	};
+
 	struct TestCase {
 		std::function<bool()> test;
 		std::string description;
 		std::string suite;
 		std::vector<std::function<void()>> beforeList, afterList;
+		// Identifies the test in the result cache (zero when caching is off).
+		uint64_t resultKey;
+		// A hash of the cache key the result is made against.
+		uint64_t cacheScope;
+		// Benchmarks run on a core reserved for them.
+		bool benchmark;
+		Resources resources;
+		// Produces the tests of a generated suite, one at a time, returning
+		// false once there are none left. Empty for other tests.
+		std::function<bool(GeneratedTest&)> generate;
+	};
+
+	// A test's record in the stability statistics file.
+	struct TestStats {
+		// Attempts made and attempts passed, over all runs.
+		int attempts, passes;
+		// Runs in which the test failed and then passed on a retry.
+		int flakyRuns;
+		std::string name;
+	};
+
+	// The outcome of one test, recorded by the worker which ran it.
+	struct TestResult {
+		uint64_t resultKey, cacheScope, statsKey;
+		int attempts;
+		bool passed, flaky, cached;
+		// The test's name in the statistics file (only set when keeping statistics).
+		std::string name;
+	};
+
+	// An entry in the result cache.
+	struct CachedResult {
+		// Hashes of the binary which wrote the entry, and of the
+		// cache key the result was made against.
+		uint64_t owner, scope;
+	};
+
+	// The results recorded by one worker. Padded so that workers
+	// appending to neighbouring slabs do not share a cache line.
+	struct ResultSlab {
+		std::vector<TestResult> results;
+		char padding[64];
+	};
+
+	// The locks and weight held by the tests running in a suite, for
+	// suites in which some tests declare resources.
+	struct ResourceQueue {
+		std::mutex mutex;
+		// Signalled whenever a test releases its resources.
+		std::condition_variable released;
+		std::unordered_set<std::string> held;
+		// The total weight of running tests, and the most allowed.
+		int weight, budget;
 	};
 
 	struct PendingTestCase {
@@ -74,9 +166,57 @@ namespace Earl {
 
 	class Test {
 	private:
-		static int testsFailed, testsRun, maxThreads;
-		static bool runAsync;
+		// Returned by Test::acquireTest once no tests are waiting.
+		static const size_t npos = static_cast<size_t>(-1);
+		// Live result counts, safe to read while tests are running.
+		static std::atomic<int> testsFailed, testsRun, testsCached, testsFlaky;
+		static int maxThreads, maxRetries;
+		// EARL_MAX_THREADS, the most threads the process may use when it
+		// shares the machine (as under earl-run), or 0 for no limit.
+		static int threadLimit;
+		static bool runAsync, fullRun;
 		static std::string currentSuite;
+		// The cache key of the current suite, if one was given to Test::describe.
+		static std::string currentCacheKey;
+		// The resources every test of the current suite needs.
+		static Resources currentResources;
+		// The file results are cached in, or empty if caching is off.
+		static std::string cacheFile;
+		// The cache key used for suites without one (a hash of the test binary).
+		static std::string binaryCacheKey;
+		// The entries of the result cache, by key.
+		static std::unordered_map<uint64_t, CachedResult> cachedResults;
+		// Keys of the tests which passed (or were cached) in this run,
+		// with their cache scopes.
+		static std::unordered_map<uint64_t, uint64_t> passedResults;
+		// Keys of the tests which failed or were flaky in this run.
+		static std::unordered_set<uint64_t> failedResults;
+		// The cache scopes of every test made since the cache was opened.
+		static std::unordered_set<uint64_t> cacheScopes;
+		// Identifies this binary's entries in the result cache.
+		static uint64_t cacheOwner;
+		// The file stability statistics are kept in, or empty if they are not kept.
+		static std::string statsFile;
+		// Stability statistics of every test seen, keyed on suite and description.
+		static std::unordered_map<uint64_t, TestStats> testStats;
+		// The file a trace of the run is written to, or empty if not tracing.
+		static std::string traceFile;
+		// The CPUs workers are pinned to, or empty to use every available CPU.
+		static std::vector<int> cpuSet;
+		// Whether workers are spread across NUMA nodes.
+		static bool numaSpread;
+		// Whether each test's resource usage is measured and printed.
+		static bool trackUsage;
+		// Whether each attempt at a test runs in a child process.
+		static bool isolated;
+		// The directory fuzzing corpora are kept in, or empty to keep them in memory.
+		static std::string fuzzCorpus;
+		// The number of inputs each fuzz test tries.
+		static size_t fuzzRuns;
+		// Only tests whose suite and description contain the filter are run.
+		static std::string filter;
+		// Only tests which hash to shardIndex (of shardCount) are run.
+		static int shardIndex, shardCount;
 		// The list of functions run before each test.
 		static std::vector<std::function<void()>> beforeEachList;
 		// The list of functions run before the next test.
@@ -89,9 +229,9 @@ namespace Earl {
 		static std::vector<TestCase> testList;
 		// Stores the descriptions of pending tests
 		static std::vector<PendingTestCase> pendingTest;
-
-		// Mutex used for protecting stdout
-		static std::mutex testCountMutex;
+		// One list of results per worker, so that workers never contend
+		// when recording a result. Merged at the end of Test::runTests.
+		static std::vector<ResultSlab> resultSlabs;
 
 		/**
 		 * Test::runTest
@@ -99,8 +239,181 @@ namespace Earl {
 		 * Run one component test. Related befores and afters are run in their
 		 * respected positions of the test.
 		 * @param testCase - The test case which will be run
+		 * @param worker - The index of the worker running the test
+		 */
+		static void runTest(const TestCase& testCase, size_t worker);
+
+		/**
+		 * Test::threadBudget
+		 * -------------------
+		 * Returns the number of threads a suite may use, or a number
+		 * less than zero if there is no limit. EARL_MAX_THREADS caps
+		 * whatever Test::setMaxConcurrency asked for.
+		 */
+		static int threadBudget();
+
+		/**
+		 * Test::cores
+		 * -------------------
+		 * Returns the hardware concurrency, capped by EARL_MAX_THREADS.
+		 */
+		static int cores();
+
+		/**
+		 * Test::makeTest
+		 * -------------------
+		 * Create a test case in the current suite, with the current
+		 * befores and afters.
+		 * @param description - Describes the function of the test
+		 * @param lambda - The test to run
+		 */
+		static TestCase makeTest(const std::string& description, const std::function<bool()>& lambda);
+
+		/**
+		 * Test::addTest
+		 * -------------------
+		 * Queue a test, or run it straight away when running synchronously.
+		 * @param test - The test case to add
+		 */
+		static void addTest(const TestCase& test);
+
+		/**
+		 * Test::fromGenerated
+		 * -------------------
+		 * Make a generated test into a test case of its suite, without
+		 * the suite's befores and afters.
+		 * @param source - The suite's generator entry
+		 * @param generated - The generated test
+		 */
+		static TestCase fromGenerated(const TestCase& source, const GeneratedTest& generated);
+
+		/**
+		 * Test::selected
+		 * -------------------
+		 * Returns whether a test passes the filter and belongs to this shard.
+		 * @param test - The test case to check
+		 */
+		static bool selected(const TestCase& test);
+
+		/**
+		 * Test::placement
+		 * -------------------
+		 * Returns the CPUs workers are placed on, in the order workers
+		 * are pinned to them. The last CPU is the one reserved for
+		 * benchmarks.
+		 */
+		static std::vector<int> placement();
+
+		/**
+		 * Test::unpinned
+		 * -------------------
+		 * Run body with the calling worker allowed on every CPU workers
+		 * are placed on, so that threads it starts (which inherit its
+		 * mask) are not confined to the worker's own CPU.
+		 * @param body - The function to run
+		 */
+		static void unpinned(const std::function<void()>&);
+
+		/**
+		 * Test::runSuite
+		 * -------------------
+		 * Run the tests in testList[begin, end) on a pool of workers,
+		 * returning once they have all finished.
+		 * @param begin - Index of the suite's first test
+		 * @param end - Index one past the suite's last test
+		 */
+		static void runSuite(size_t begin, size_t end);
+
+		/**
+		 * Test::acquireTest
+		 * -------------------
+		 * Wait until one of the waiting tests can run without exceeding
+		 * the weight budget or sharing a lock, then take its resources.
+		 * A test heavier than the whole budget runs on its own.
+		 * @param resources - The suite's resources
+		 * @param waiting - Indices of the tests yet to start; the chosen
+		 *				test is removed.
+		 * @param weighed - Whether the test's weight counts against the budget
+		 * @return The chosen test's index, or npos once none are waiting.
+		 */
+		static size_t acquireTest(ResourceQueue& resources, std::vector<size_t>& waiting, bool weighed);
+
+		/**
+		 * Test::releaseTest
+		 * -------------------
+		 * Give back the resources taken by Test::acquireTest.
+		 * @param resources - The suite's resources
+		 * @param testCase - The test which finished
+		 * @param weighed - Whether the test's weight counted against the budget
+		 */
+		static void releaseTest(ResourceQueue& resources, const TestCase& testCase, bool weighed);
+
+		/**
+		 * Test::mergeResults
+		 * -------------------
+		 * Fold the workers' result slabs into the result
+		 * cache and the stability statistics.
+		 */
+		static void mergeResults();
+
+		/**
+		 * Test::attemptTest
+		 * -------------------
+		 * Run a test once, along with its befores and afters.
+		 * @param testCase - The test case which will be run
+		 * @param worker - The index of the worker running the test
+		 * @return Whether the test passed.
+		 */
+		static bool attemptTest(const TestCase& testCase, size_t worker);
+
+		/**
+		 * Test::attemptIsolated
+		 * -------------------
+		 * Run a test once in a child process, along with its befores and
+		 * afters, adding the child's resource usage to usage. A child
+		 * which crashes fails the test.
+		 * @param testCase - The test case which will be run
+		 * @param worker - The index of the worker running the test
+		 * @param usage - Accumulates the resource usage of each attempt
+		 * @return Whether the test passed.
 		 */
-		static void runTest(std::shared_ptr<TestCase> testCase);
+		static bool attemptIsolated(const TestCase& testCase, size_t worker, ResourceUsage& usage);
+
+		/**
+		 * Test::skipCached
+		 * -------------------
+		 * Report a test as cached if it passed in the previous run
+		 * against the same cache key.
+		 * @param testCase - The test case which is about to be run
+		 * @param worker - The index of the worker running the test
+		 * @return Whether the test was skipped.
+		 */
+		static bool skipCached(const TestCase& testCase, size_t worker);
+
+		/**
+		 * Test::writeResultCache
+		 * -------------------
+		 * Merge the tests that passed in this run into the result cache,
+		 * and drop those which failed. This binary's entries made against
+		 * a cache key it no longer uses (an earlier build, or a suite's
+		 * old key) are left out of the file.
+		 */
+		static void writeResultCache();
+
+		/**
+		 * Test::writeStats
+		 * -------------------
+		 * Replace the statistics file with the updated statistics.
+		 */
+		static void writeStats();
+
+		/**
+		 * Test::writeReport
+		 * -------------------
+		 * Append the counts of this run to the file named by
+		 * EARL_REPORT_FILE, for earl-run to merge.
+		 */
+		static void writeReport();
 	public:
 		Test();
 		~Test();
@@ -137,6 +450,30 @@ namespace Earl {
 		 * @param lambda - The function to run, after the description has been printed.
 		 */
 		static void describe(std::string, std::function<void()>);
+
+		/**
+		 * Test::describe
+		 * -------------------
+		 * Describe a set of tests to be executed, with the key their results
+		 * are cached under. Tests which passed against the same key in the
+		 * previous run are skipped. Without a key, a hash of the test binary
+		 * is used.
+		 * @param description - Describes the set of tests to be run
+		 * @param cacheKey - Changes whenever the tests' results may change
+		 * @param lambda - The function to run, after the description has been printed.
+		 */
+		static void describe(std::string, std::string, std::function<void()>);
+
+		/**
+		 * Test::describe
+		 * -------------------
+		 * Describe a set of tests to be executed which all need the same
+		 * resources, in addition to any each test declares itself.
+		 * @param description - Describes the set of tests to be run
+		 * @param resources - The locks and weight of each test in the set
+		 * @param lambda - The function to run, after the description has been printed.
+		 */
+		static void describe(std::string, Resources, std::function<void()>);
 		
 		/**
 		 * Test::it
@@ -148,6 +485,20 @@ namespace Earl {
 		 * 					is said to have passed.
 		 */
 		static void it(std::string, std::function<bool()>);
+
+		/**
+		 * Test::it
+		 * -------------------
+		 * Run one component test which needs resources. When running
+		 * asynchronously, the test never overlaps another test holding
+		 * one of its locks, and counts its weight against the maximum
+		 * concurrency.
+		 * @param description - Describes the function of the test
+		 * @param resources - The locks and weight the test needs
+		 * @param lambda - The test to run. If the test returns true, the test is
+		 * 					is said to have passed.
+		 */
+		static void it(std::string, Resources, std::function<bool()>);
 		
 		/**
 		 * Test::it
@@ -158,6 +509,90 @@ namespace Earl {
 		 */
 		static void it(std::string);
 
+		/**
+		 * Test::benchmark
+		 * -------------------
+		 * Add a test which measures performance. Benchmarks run one at a
+		 * time on a core reserved for them, while the suite's other tests
+		 * run on the remaining cores. The time taken is printed alongside
+		 * the result.
+		 * @param description - Describes the function of the test
+		 * @param lambda - The test to run. If the test returns true, the test is
+		 * 					is said to have passed.
+		 */
+		static void benchmark(std::string, std::function<bool()>);
+
+		/**
+		 * Test::stress
+		 * -------------------
+		 * Add a test which runs a lambda on several threads at once, for
+		 * many iterations. Every thread is released from a spin barrier at
+		 * the start of each iteration, so that races show up within a
+		 * normal run. Failed iterations are counted per thread, and the
+		 * operations per second are printed. The test weighs as much as
+		 * its thread count.
+		 * @param description - Describes the function of the test
+		 * @param threads - The number of threads
+		 * @param iterations - The number of iterations on each thread
+		 * @param lambda - Called with the thread's index and the iteration;
+		 *				returns false if the iteration failed.
+		 * @param randomize - Randomly yield or spin after each release, to
+		 *				vary the interleaving. The seed is printed on failure,
+		 *				and can be replayed with EARL_STRESS_SEED.
+		 */
+		static void stress(std::string, int, int, std::function<bool(int, int)>, bool = false);
+
+		/**
+		 * Test::scalability
+		 * -------------------
+		 * Add a benchmark which runs a workload at 1, 2, 4... threads, up to
+		 * the hardware concurrency, and prints the throughput, speedup and
+		 * parallel efficiency of each step, flagging any step slower than
+		 * the one before. The test weighs as much as the hardware
+		 * concurrency, so it only shares the machine if the budget allows.
+		 * @param description - Describes the function of the test
+		 * @param iterations - The number of iterations on each thread
+		 * @param workload - Called with the thread's index and the iteration;
+		 *				returns false if the iteration failed.
+		 * @param check - Passed the measured curve, for assertions such as
+		 *				Assert::hasEfficiency. The test fails if it returns false.
+		 */
+		static void scalability(std::string, int, std::function<bool(int, int)>, std::function<bool(const std::vector<ScalingStep>&)> = nullptr);
+
+		/**
+		 * Test::fuzz
+		 * -------------------
+		 * Add a test which fuzzes target with a coverage-guided mutation
+		 * loop, on one worker thread per core sharing a corpus. Each input
+		 * runs between the before-each and after-each functions; as those
+		 * share their fixtures, a single worker is used while there are
+		 * any. Build the code under test with -fsanitize-coverage=trace-pc-guard
+		 * (Clang) or -fsanitize-coverage=trace-pc (GCC) for coverage. The
+		 * test fails if an input makes target return false, throw or
+		 * crash; the input is minimised and, if there is a corpus, saved
+		 * to it. Inputs run in a child process where fork is available, so
+		 * a crash fails the test and their side effects stay in the child.
+		 * @param description - Describes the function of the test
+		 * @param target - Runs one input, returning false if it exposed a bug.
+		 */
+		static void fuzz(std::string, std::function<bool(const uint8_t*, size_t)>);
+
+		/**
+		 * Test::generate
+		 * -------------------
+		 * Describe a suite whose tests are produced one at a time by a
+		 * generator, as workers become free, rather than all being added
+		 * up front. Only the tests being run are held in memory, so a
+		 * suite can be generated from a very large corpus. Before-each and
+		 * after-each functions run around every generated test; before and
+		 * after functions run around the first one, as for Test::it.
+		 * @param description - Describes the set of tests to be run
+		 * @param generator - Fills in the next test and returns true, or
+		 *				returns false once there are none left. Never called
+		 *				by two workers at once.
+		 */
+		static void generate(std::string, std::function<bool(GeneratedTest&)>);
+
 		/**
 		 * Test::beforeEach
 		 * -------------------
@@ -212,7 +647,7 @@ namespace Earl {
 		 * -------------------
 		 * Returns the number of tests that passed.
 		 */
-		static int getTestsPassed() { return testsRun - testsFailed; };
+		static int getTestsPassed() { return testsRun - testsFailed - testsFlaky; };
 
 		/**
 		 * Test::printSummary
@@ -230,17 +665,183 @@ namespace Earl {
 		 */
 		static int getTestsPending() { return pendingTest.size(); };
 
+		/**
+		 * Test::getTestsCached
+		 * -------------------
+		 * Returns the number of tests that were skipped
+		 * because they passed in the previous run.
+		 */
+		static int getTestsCached() { return testsCached; };
+
+		/**
+		 * Test::useResultCache
+		 * -------------------
+		 * Cache the results of passing tests in a file, and skip tests
+		 * which passed in the previous run against the same cache key.
+		 * Caching is off by default.
+		 * @param path - The cache file, or an empty string to turn caching off.
+		 */
+		static void useResultCache(std::string);
+
+		/**
+		 * Test::forceFullRun
+		 * -------------------
+		 * Run every test even if its result is cached. The cache
+		 * is still updated. Defaults to true when the EARL_FULL_RUN
+		 * environment variable is set to anything but 0.
+		 * @param force - Set to true to ignore cached results.
+		 */
+		static void forceFullRun(bool);
+
+		/**
+		 * Test::getTestsFlaky
+		 * -------------------
+		 * Returns the number of tests that failed, but
+		 * then passed when retried.
+		 */
+		static int getTestsFlaky() { return testsFlaky; };
+
+		/**
+		 * Test::setRetries
+		 * -------------------
+		 * Retry failing tests up to retryCount times. A test which
+		 * passes on a retry is reported as flaky rather than failed.
+		 * Retries run on the same worker as the failed attempt.
+		 * @param retryCount - The number of retries (defaults to none).
+		 */
+		static void setRetries(int);
+
+		/**
+		 * Test::useStatsFile
+		 * -------------------
+		 * Keep the number of attempts, passes and flaky runs of every
+		 * test in a file, across retries and across runs, and print a
+		 * flaky test's pass rate alongside it.
+		 * @param path - The statistics file, or an empty string to stop
+		 *				keeping statistics.
+		 */
+		static void useStatsFile(std::string);
+
+		/**
+		 * Test::setTraceFile
+		 * -------------------
+		 * Record when each worker runs each test, hook and suite barrier,
+		 * and write it to a Chrome trace-event JSON file at the end of
+		 * Test::runTests. Tracing is off by default.
+		 * @param path - The trace file, or an empty string to turn tracing off.
+		 */
+		static void setTraceFile(std::string);
+
+		/**
+		 * Test::setMetricsFile
+		 * -------------------
+		 * Write live metrics of the run (tests completed, failed and
+		 * queued, in-flight tests, throughput and worker utilisation) to
+		 * a file in the Prometheus text format, refreshed every interval.
+		 * @param path - The metrics file, or an empty string to stop writing metrics.
+		 * @param interval - Milliseconds between refreshes.
+		 */
+		static void setMetricsFile(std::string, int = DEFAULT_METRICS_INTERVAL_MS);
+
 		/**
 		 * Test::setMaxConcurrency
 		 * -------------------
 		 * Affects the number of threads that can be
-		 * launched in asynchronous mode. Setting threadCount
+		 * launched in asynchronous mode, and the total
+		 * weight of tests which can run at once. Setting threadCount
 		 * to a number less than zero means there is no limit
-		 * to the number of threads that can be launched.
+		 * to the number of threads that can be launched. If
+		 * EARL_MAX_THREADS is set, it caps threadCount.
 		 * @param threadCount - The maximum number of threads to use
 		 *						whilst running tests.
 		 */
 		static void setMaxConcurrency(int);
+
+		/**
+		 * Test::setCpuAffinity
+		 * -------------------
+		 * Pin each worker to one CPU of a set, in order, so that tests
+		 * do not migrate between cores. Only supported on Linux.
+		 * @param cpus - The CPUs to run tests on, or an empty list to let
+		 *				workers float across every available CPU.
+		 */
+		static void setCpuAffinity(std::vector<int>);
+
+		/**
+		 * Test::spreadAcrossNumaNodes
+		 * -------------------
+		 * Pin each worker to one CPU, alternating between NUMA nodes so
+		 * that memory-heavy tests are spread evenly across them. Applies
+		 * to the CPUs given to Test::setCpuAffinity, or to every available
+		 * CPU. Only supported on Linux.
+		 * @param spread - Set to true to spread workers across nodes.
+		 */
+		static void spreadAcrossNumaNodes(bool);
+
+		/**
+		 * Test::setFuzzCorpus
+		 * -------------------
+		 * Keep fuzzing corpora in directory/<test description>. Inputs there
+		 * seed each run, new inputs and crashes are saved there, and crashes
+		 * saved by an earlier run are replayed first.
+		 * @param directory - The corpus directory, or an empty string to
+		 *				keep corpora in memory (the default).
+		 */
+		static void setFuzzCorpus(std::string);
+
+		/**
+		 * Test::setFuzzRuns
+		 * -------------------
+		 * Set the number of inputs each fuzz test tries, over all of
+		 * its workers (defaults to DEFAULT_FUZZ_RUNS).
+		 * @param runs - The number of inputs
+		 */
+		static void setFuzzRuns(size_t);
+
+		/**
+		 * Test::setFilter
+		 * -------------------
+		 * Only run the tests whose suite and description, joined by a space,
+		 * contain pattern. Defaults to the EARL_FILTER environment variable.
+		 * @param pattern - The text to look for, or an empty string to run
+		 *				every test.
+		 */
+		static void setFilter(std::string);
+
+		/**
+		 * Test::setShard
+		 * -------------------
+		 * Split the tests between several runs by a hash of their suite and
+		 * description, and only run this run's share. Defaults to the
+		 * EARL_SHARD_INDEX and EARL_TOTAL_SHARDS environment variables.
+		 * @param index - This run's shard, from zero
+		 * @param count - The number of shards, or one to run every test
+		 */
+		static void setShard(int, int);
+
+		/**
+		 * Test::trackResourceUsage
+		 * -------------------
+		 * Measure the page faults, context switches and peak resident set
+		 * growth of each test, and print them alongside its result. Faults
+		 * and switches are counted on the test's thread. Peak growth is
+		 * exact when tests run synchronously or isolated, and otherwise
+		 * only counts growth beyond the process's previous peak. Only
+		 * supported on Linux.
+		 * @param track - Set to true to measure resource usage.
+		 */
+		static void trackResourceUsage(bool);
+
+		/**
+		 * Test::isolateTests
+		 * -------------------
+		 * Run each attempt at a test in a child process of its own, so that
+		 * a crash only fails that test and its resource usage is exact.
+		 * Results written to memory by the test are lost with the child.
+		 * Not supported on Windows, where tests keep running in-process.
+		 * @param isolate - Set to true to run tests in child processes.
+		 */
+		static void isolateTests(bool);
 	};
 
 };
\ No newline at end of file
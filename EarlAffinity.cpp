@@ -0,0 +1,242 @@
+/*******************************************************************************
+ * Copyright (c) 2014, Niall Frederick Weedon and other Contributors
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without modification, 
+ * are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, this 
+ * list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ * this list of conditions and the following disclaimer in the documentation and/or 
+ * other materials provided with the distribution.
+ * 
+ * 3. Neither the name of the copyright holder nor the names of its contributors may
+ * be used to endorse or promote products derived from this software without 
+ * specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE 
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE 
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL 
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR 
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, 
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE 
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *******************************************************************************/
+#include "EarlAffinity.h"
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+
+#ifdef __linux__
+	#include <dirent.h>
+	#include <sched.h>
+#endif
+
+namespace Earl {
+	/**
+	 * Affinity::parseCpuList
+	 * -------------------
+	 * Parse a kernel CPU list such as "0-3,8,10-11".
+	 * @param list - The list to parse
+	 * @return The CPUs in the list, in ascending order.
+	 */
+	std::vector<int> Affinity::parseCpuList(const std::string& list) {
+		std::vector<int> cpus;
+		const char* cursor = list.c_str();
+
+		while(*cursor != '\0') {
+			char* rangeEnd;
+			long first = std::strtol(cursor, &rangeEnd, 10);
+			long last = first;
+
+			if(rangeEnd == cursor) {
+				cursor++;
+				continue;
+			}
+
+			cursor = rangeEnd;
+
+			if(*cursor == '-') {
+				last = std::strtol(cursor + 1, &rangeEnd, 10);
+				cursor = rangeEnd;
+			}
+
+			for(long cpu = first; cpu <= last; cpu++) {
+				cpus.push_back(static_cast<int>(cpu));
+			}
+		}
+
+		std::sort(cpus.begin(), cpus.end());
+		cpus.erase(std::unique(cpus.begin(), cpus.end()), cpus.end());
+		return cpus;
+	}
+
+#ifdef __linux__
+	/**
+	 * maskCpus
+	 * -------------------
+	 * Returns the CPUs set in an affinity mask.
+	 */
+	static std::vector<int> maskCpus(const cpu_set_t& mask) {
+		std::vector<int> cpus;
+
+		for(int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+			if(CPU_ISSET(cpu, &mask)) {
+				cpus.push_back(cpu);
+			}
+		}
+
+		return cpus;
+	}
+#endif
+
+	/**
+	 * Affinity::available
+	 * -------------------
+	 * Returns the CPUs the process is allowed to run on.
+	 */
+	std::vector<int> Affinity::available() {
+#ifdef __linux__
+		// Threads inherit their affinity, so the main thread's
+		// mask stands in for the process's.
+		cpu_set_t mask;
+		CPU_ZERO(&mask);
+
+		std::ifstream status("/proc/self/status");
+		std::string line;
+
+		while(std::getline(status, line)) {
+			if(line.compare(0, 19, "Cpus_allowed_list:\t") == 0) {
+				return parseCpuList(line.substr(19));
+			}
+		}
+
+		if(sched_getaffinity(0, sizeof(mask), &mask) == 0) {
+			return maskCpus(mask);
+		}
+#endif
+		return std::vector<int>();
+	}
+
+	/**
+	 * Affinity::current
+	 * -------------------
+	 * Returns the CPUs the calling thread is allowed to run on.
+	 */
+	std::vector<int> Affinity::current() {
+#ifdef __linux__
+		cpu_set_t mask;
+		CPU_ZERO(&mask);
+
+		if(sched_getaffinity(0, sizeof(mask), &mask) == 0) {
+			return maskCpus(mask);
+		}
+#endif
+		return std::vector<int>();
+	}
+
+	/**
+	 * Affinity::numaNodes
+	 * -------------------
+	 * Returns the CPUs of each NUMA node, read from
+	 * /sys/devices/system/node. Empty if the topology is unknown.
+	 */
+	std::vector<std::vector<int>> Affinity::numaNodes() {
+		std::vector<std::vector<int>> nodes;
+#ifdef __linux__
+		DIR* directory = opendir("/sys/devices/system/node");
+
+		if(directory == nullptr) {
+			return nodes;
+		}
+
+		std::vector<int> ids;
+
+		for(dirent* entry = readdir(directory); entry != nullptr; entry = readdir(directory)) {
+			std::string name = entry->d_name;
+
+			if(name.compare(0, 4, "node") == 0 && name.size() > 4 &&
+				name.find_first_not_of("0123456789", 4) == std::string::npos) {
+				ids.push_back(std::atoi(name.c_str() + 4));
+			}
+		}
+
+		closedir(directory);
+		std::sort(ids.begin(), ids.end());
+
+		for(int id : ids) {
+			std::ifstream file("/sys/devices/system/node/node" + std::to_string(id) + "/cpulist");
+			std::string list;
+
+			// Memory-only nodes have no CPUs to place workers on.
+			if(std::getline(file, list) && !parseCpuList(list).empty()) {
+				nodes.push_back(parseCpuList(list));
+			}
+		}
+#endif
+		return nodes;
+	}
+
+	/**
+	 * Affinity::spread
+	 * -------------------
+	 * Order CPUs so that consecutive entries alternate between NUMA
+	 * nodes, so that workers pinned in order are spread evenly.
+	 * @param cpus - The CPUs to order
+	 */
+	std::vector<int> Affinity::spread(const std::vector<int>& cpus) {
+		std::vector<std::vector<int>> nodes = numaNodes();
+		std::vector<std::vector<int>> perNode(nodes.size() + 1);
+		std::vector<int> ordered;
+
+		// CPUs missing from the topology are treated as one more node.
+		for(int cpu : cpus) {
+			size_t node = 0;
+
+			while(node < nodes.size() && std::find(nodes[node].begin(), nodes[node].end(), cpu) == nodes[node].end()) {
+				node++;
+			}
+
+			perNode[node].push_back(cpu);
+		}
+
+		for(size_t i = 0; ordered.size() < cpus.size(); i++) {
+			for(auto& node : perNode) {
+				if(i < node.size()) {
+					ordered.push_back(node[i]);
+				}
+			}
+		}
+
+		return ordered;
+	}
+
+	/**
+	 * Affinity::pin
+	 * -------------------
+	 * Restrict the calling thread to a set of CPUs.
+	 * @param cpus - The CPUs to run on
+	 * @return Whether the thread was pinned.
+	 */
+	bool Affinity::pin(const std::vector<int>& cpus) {
+#ifdef __linux__
+		cpu_set_t mask;
+		CPU_ZERO(&mask);
+
+		for(int cpu : cpus) {
+			if(cpu >= 0 && cpu < CPU_SETSIZE) {
+				CPU_SET(cpu, &mask);
+			}
+		}
+
+		return CPU_COUNT(&mask) > 0 && sched_setaffinity(0, sizeof(mask), &mask) == 0;
+#else
+		return false;
+#endif
+	}
+};
@@ -0,0 +1,94 @@
+/*******************************************************************************
+ * Copyright (c) 2014, Niall Frederick Weedon and other Contributors
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without modification, 
+ * are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, this 
+ * list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ * this list of conditions and the following disclaimer in the documentation and/or 
+ * other materials provided with the distribution.
+ * 
+ * 3. Neither the name of the copyright holder nor the names of its contributors may
+ * be used to endorse or promote products derived from this software without 
+ * specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE 
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE 
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL 
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR 
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, 
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE 
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *******************************************************************************/
+#pragma once
+
+#include <string>
+#include <vector>
+
+namespace Earl {
+	/**
+	 * Affinity
+	 * -------------------
+	 * Reads the CPU and NUMA topology and pins threads to CPUs. Pinning
+	 * is only supported on Linux; elsewhere every CPU list is empty and
+	 * pinning does nothing.
+	 */
+	class Affinity {
+	public:
+		/**
+		 * Affinity::parseCpuList
+		 * -------------------
+		 * Parse a kernel CPU list such as "0-3,8,10-11".
+		 * @param list - The list to parse
+		 * @return The CPUs in the list, in ascending order.
+		 */
+		static std::vector<int> parseCpuList(const std::string&);
+
+		/**
+		 * Affinity::available
+		 * -------------------
+		 * Returns the CPUs the process is allowed to run on.
+		 */
+		static std::vector<int> available();
+
+		/**
+		 * Affinity::current
+		 * -------------------
+		 * Returns the CPUs the calling thread is allowed to run on.
+		 */
+		static std::vector<int> current();
+
+		/**
+		 * Affinity::numaNodes
+		 * -------------------
+		 * Returns the CPUs of each NUMA node, read from
+		 * /sys/devices/system/node. Empty if the topology is unknown.
+		 */
+		static std::vector<std::vector<int>> numaNodes();
+
+		/**
+		 * Affinity::spread
+		 * -------------------
+		 * Order CPUs so that consecutive entries alternate between NUMA
+		 * nodes, so that workers pinned in order are spread evenly.
+		 * @param cpus - The CPUs to order
+		 */
+		static std::vector<int> spread(const std::vector<int>&);
+
+		/**
+		 * Affinity::pin
+		 * -------------------
+		 * Restrict the calling thread to a set of CPUs.
+		 * @param cpus - The CPUs to run on
+		 * @return Whether the thread was pinned.
+		 */
+		static bool pin(const std::vector<int>&);
+	};
+};
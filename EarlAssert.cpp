@@ -28,8 +28,23 @@
  * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  *******************************************************************************/ 
 #include "EarlAssert.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <sstream>
+
+// Lines of each side shown when a text snapshot differs.
+#define SNAPSHOT_CONTEXT_LINES 3
+// Longest line shown in a snapshot diff.
+#define SNAPSHOT_LINE_LIMIT 120
+// Furthest a snapshot diff searches back for the start of a line.
+#define SNAPSHOT_LINE_SEARCH 4096
 
 namespace Earl {
+	bool Assert::snapshotUpdate = std::getenv("EARL_UPDATE_SNAPSHOTS") != nullptr &&
+		std::strcmp(std::getenv("EARL_UPDATE_SNAPSHOTS"), "0") != 0;
+
 	/**
 	 * Assert::isTruthy
 	 * -------------------
@@ -76,4 +91,477 @@ namespace Earl {
 		return isFalsy(falsiness);
 	}
 
+	/**
+	 * Assert::isEqualBuffer
+	 * -------------------
+	 * Compare whether two buffers hold the same bytes. On failure, the
+	 * first differing offset, the number of differing bytes and a hex
+	 * dump around the first difference are printed.
+	 * @param first - First buffer to compare
+	 * @param second - Second buffer to compare
+	 * @param size - Size of both buffers in bytes
+	 */
+	bool Assert::isEqualBuffer(const void* first, const void* second, size_t size) {
+		size_t firstMismatch;
+		size_t mismatches;
+
+		if(size == 0) {
+			return true;
+		}
+
+		if(!first || !second) {
+			return false;
+		}
+
+		mismatches = Compare::elements(first, second, size, 1, &firstMismatch);
+
+		if(mismatches > 0) {
+			printMismatch(first, second, size, 1, firstMismatch, mismatches);
+		}
+
+		return mismatches == 0;
+	}
+
+	/**
+	 * Assert::isEqualBuffer
+	 * -------------------
+	 * Compare whether two buffers hold the same bytes,
+	 * adding a comment to the assertion.
+	 * @param first - First buffer to compare
+	 * @param second - Second buffer to compare
+	 * @param size - Size of both buffers in bytes
+	 * @param outputMessage - The comment to be printed to stdout.
+	 */
+	bool Assert::isEqualBuffer(const void* first, const void* second, size_t size, std::string outputMessage) {
+		Print::line(ASSERT_OUTPUT + outputMessage, GREY);
+		return isEqualBuffer(first, second, size);
+	}
+
+	/**
+	 * Assert::isNear
+	 * -------------------
+	 * Compare whether every pair of values lies within tolerance. On
+	 * failure, the largest error, its index and a histogram of the
+	 * errors are printed.
+	 * @param first - First array to compare
+	 * @param second - Second array to compare
+	 * @param count - Number of values in each array
+	 * @param tolerance - The largest error allowed
+	 * @param mode - How the error is measured (defaults to absolute)
+	 */
+	bool Assert::isNear(const float* first, const float* second, size_t count, double tolerance, Tolerance mode) {
+		if(count == 0) {
+			return true;
+		}
+
+		if(!first || !second) {
+			return false;
+		}
+
+		if(Compare::near(first, second, count, tolerance, mode)) {
+			return true;
+		}
+
+		ToleranceReport report = Compare::tolerance(first, second, count, tolerance, mode);
+		printTolerance(report, count, tolerance, mode, first[report.maxIndex], second[report.maxIndex]);
+		return report.failures == 0;
+	}
+
+	/**
+	 * Assert::isNear
+	 * -------------------
+	 * Compare whether every pair of values lies within tolerance,
+	 * adding a comment to the assertion.
+	 * @param first - First array to compare
+	 * @param second - Second array to compare
+	 * @param count - Number of values in each array
+	 * @param tolerance - The largest error allowed
+	 * @param mode - How the error is measured
+	 * @param outputMessage - The comment to be printed to stdout.
+	 */
+	bool Assert::isNear(const float* first, const float* second, size_t count, double tolerance, Tolerance mode, std::string outputMessage) {
+		Print::line(ASSERT_OUTPUT + outputMessage, GREY);
+		return isNear(first, second, count, tolerance, mode);
+	}
+
+	bool Assert::isNear(const double* first, const double* second, size_t count, double tolerance, Tolerance mode) {
+		if(count == 0) {
+			return true;
+		}
+
+		if(!first || !second) {
+			return false;
+		}
+
+		if(Compare::near(first, second, count, tolerance, mode)) {
+			return true;
+		}
+
+		ToleranceReport report = Compare::tolerance(first, second, count, tolerance, mode);
+		printTolerance(report, count, tolerance, mode, first[report.maxIndex], second[report.maxIndex]);
+		return report.failures == 0;
+	}
+
+	bool Assert::isNear(const double* first, const double* second, size_t count, double tolerance, Tolerance mode, std::string outputMessage) {
+		Print::line(ASSERT_OUTPUT + outputMessage, GREY);
+		return isNear(first, second, count, tolerance, mode);
+	}
+
+	/**
+	 * Assert::hasEfficiency
+	 * -------------------
+	 * Return whether a scalability curve reaches a parallel
+	 * efficiency at a thread count.
+	 * @param steps - The curve measured by Stress::scale
+	 * @param threads - The thread count to check
+	 * @param minimum - The lowest acceptable efficiency, from 0 to 1
+	 */
+	bool Assert::hasEfficiency(const std::vector<ScalingStep>& steps, int threads, double minimum) {
+		std::ostringstream summary;
+
+		for(auto& step : steps) {
+			if(step.threads == threads) {
+				if(step.efficiency >= minimum) {
+					return true;
+				}
+
+				summary << "efficiency at " << threads << " threads is " << static_cast<int>(step.efficiency * 100)
+						<< "%, below " << static_cast<int>(minimum * 100) << "%";
+				Print::line(ASSERT_OUTPUT + summary.str(), GREY);
+				return false;
+			}
+		}
+
+		summary << "no measurement at " << threads << " threads";
+		Print::line(ASSERT_OUTPUT + summary.str(), GREY);
+		return false;
+	}
+
+	/**
+	 * Assert::hasEfficiency
+	 * -------------------
+	 * Return whether a scalability curve reaches a parallel
+	 * efficiency at a thread count, adding a comment to the assertion.
+	 * @param steps - The curve measured by Stress::scale
+	 * @param threads - The thread count to check
+	 * @param minimum - The lowest acceptable efficiency, from 0 to 1
+	 * @param outputMessage - The comment to print when making the assertion
+	 */
+	bool Assert::hasEfficiency(const std::vector<ScalingStep>& steps, int threads, double minimum, std::string outputMessage) {
+		Print::line(ASSERT_OUTPUT + outputMessage, GREY);
+		return hasEfficiency(steps, threads, minimum);
+	}
+
+	/**
+	 * Assert::isWithinMemory
+	 * -------------------
+	 * Return whether the running test's peak resident set size has grown
+	 * by no more than ceiling. Requires Test::trackResourceUsage or
+	 * Test::isolateTests.
+	 * @param ceiling - The most the peak may grow by, in bytes
+	 */
+	bool Assert::isWithinMemory(size_t ceiling) {
+		long growth = Usage::peakGrowth();
+		std::ostringstream summary;
+
+		if(growth < 0) {
+			Print::line(std::string(ASSERT_OUTPUT) + "memory is only measured with Test::trackResourceUsage or Test::isolateTests", GREY);
+			return false;
+		}
+
+		if(static_cast<size_t>(growth) * 1024 <= ceiling) {
+			return true;
+		}
+
+		summary << "peak RSS grew by " << growth << " KiB, over the ceiling of " << ceiling / 1024 << " KiB";
+		Print::line(ASSERT_OUTPUT + summary.str(), GREY);
+		return false;
+	}
+
+	/**
+	 * Assert::isWithinMemory
+	 * -------------------
+	 * Return whether the running test's peak resident set size has grown
+	 * by no more than ceiling, adding a comment to the assertion.
+	 * @param ceiling - The most the peak may grow by, in bytes
+	 * @param outputMessage - The comment to print when making the assertion
+	 */
+	bool Assert::isWithinMemory(size_t ceiling, std::string outputMessage) {
+		Print::line(ASSERT_OUTPUT + outputMessage, GREY);
+		return isWithinMemory(ceiling);
+	}
+
+	/**
+	 * Assert::printMismatch
+	 * -------------------
+	 * Print the diagnostics for a failed range comparison.
+	 * @param first - First range compared
+	 * @param second - Second range compared
+	 * @param count - Number of elements in each range
+	 * @param width - Size of one element in bytes, or zero if the
+	 *				elements cannot be shown as raw bytes.
+	 * @param firstMismatch - Index of the first differing element
+	 * @param mismatches - Number of differing elements
+	 */
+	void Assert::printMismatch(const void* first, const void* second, size_t count, size_t width, size_t firstMismatch, size_t mismatches) {
+		std::ostringstream summary;
+
+		summary << mismatches << " of " << count << (width == 1 ? " bytes" : " elements")
+				<< " differ, first at " << (width == 1 ? "offset " : "index ") << firstMismatch;
+		Print::line(ASSERT_OUTPUT + summary.str(), GREY);
+
+		if(width == 0) {
+			return;
+		}
+
+		std::istringstream window(Compare::hexWindow(first, second, count * width, firstMismatch * width));
+		std::string row;
+
+		while(std::getline(window, row)) {
+			Print::line(ASSERT_OUTPUT + row, GREY);
+		}
+	}
+
+	/**
+	 * Assert::printTolerance
+	 * -------------------
+	 * Print the diagnostics for a failed tolerance comparison.
+	 * @param report - The errors measured by Compare::tolerance
+	 * @param count - Number of values compared
+	 * @param tolerance - The largest error allowed
+	 * @param mode - How the error was measured
+	 * @param firstValue - The first value at the largest error
+	 * @param secondValue - The second value at the largest error
+	 */
+	void Assert::printTolerance(const ToleranceReport& report, size_t count, double tolerance, Tolerance mode, double firstValue, double secondValue) {
+		const char* modes[] = { "absolute", "relative", "ulp" };
+		std::ostringstream summary, histogram;
+
+		if(report.failures == 0) {
+			return;
+		}
+
+		summary << report.failures << " of " << count << " values outside " << modes[static_cast<int>(mode)]
+				<< " tolerance " << tolerance << ", max error " << report.maxError << " at index "
+				<< report.maxIndex << std::setprecision(17) << " (" << firstValue << " vs " << secondValue << ")";
+		Print::line(ASSERT_OUTPUT + summary.str(), GREY);
+
+		histogram << "error histogram: within " << report.histogram[0]
+				  << " | <=10x " << report.histogram[1]
+				  << " | <=100x " << report.histogram[2]
+				  << " | <=1000x " << report.histogram[3]
+				  << " | >1000x " << report.histogram[4]
+				  << " | nan " << report.histogram[5];
+		Print::line(ASSERT_OUTPUT + histogram.str(), GREY);
+	}
+
+	/**
+	 * Assert::matchesSnapshot
+	 * -------------------
+	 * Compare a buffer against the golden file at goldenPath. The golden
+	 * file is memory-mapped and compared in place. When snapshots are being
+	 * updated, a missing or differing golden file is rewritten with data
+	 * instead, and the assertion passes.
+	 * @param data - The buffer to compare
+	 * @param size - Size of the buffer in bytes
+	 * @param goldenPath - The golden file to compare against
+	 */
+	bool Assert::matchesSnapshot(const void* data, size_t size, std::string goldenPath) {
+		if(size > 0 && !data) {
+			return false;
+		}
+
+		return compareSnapshot(static_cast<const unsigned char*>(data), size, goldenPath);
+	}
+
+	/**
+	 * Assert::matchesSnapshot
+	 * -------------------
+	 * Compare a buffer against the golden file at goldenPath,
+	 * adding a comment to the assertion.
+	 * @param data - The buffer to compare
+	 * @param size - Size of the buffer in bytes
+	 * @param goldenPath - The golden file to compare against
+	 * @param outputMessage - The comment to be printed to stdout.
+	 */
+	bool Assert::matchesSnapshot(const void* data, size_t size, std::string goldenPath, std::string outputMessage) {
+		Print::line(ASSERT_OUTPUT + outputMessage, GREY);
+		return matchesSnapshot(data, size, goldenPath);
+	}
+
+	/**
+	 * Assert::matchesSnapshotFile
+	 * -------------------
+	 * Compare the file at actualPath against the golden file at
+	 * goldenPath, with both files memory-mapped.
+	 * @param actualPath - The file to compare
+	 * @param goldenPath - The golden file to compare against
+	 */
+	bool Assert::matchesSnapshotFile(std::string actualPath, std::string goldenPath) {
+		MappedFile actual(actualPath);
+
+		if(!actual.isOpen()) {
+			Print::line(ASSERT_OUTPUT + std::string("cannot open ") + actualPath, GREY);
+			return false;
+		}
+
+		return compareSnapshot(actual.data(), actual.size(), goldenPath);
+	}
+
+	/**
+	 * Assert::matchesSnapshotFile
+	 * -------------------
+	 * Compare the file at actualPath against the golden file at
+	 * goldenPath, adding a comment to the assertion.
+	 * @param actualPath - The file to compare
+	 * @param goldenPath - The golden file to compare against
+	 * @param outputMessage - The comment to be printed to stdout.
+	 */
+	bool Assert::matchesSnapshotFile(std::string actualPath, std::string goldenPath, std::string outputMessage) {
+		Print::line(ASSERT_OUTPUT + outputMessage, GREY);
+		return matchesSnapshotFile(actualPath, goldenPath);
+	}
+
+	/**
+	 * Assert::updateSnapshots
+	 * -------------------
+	 * Tell Earl whether snapshot assertions should rewrite their golden
+	 * files rather than compare against them. Defaults to true when the
+	 * EARL_UPDATE_SNAPSHOTS environment variable is set to anything but 0.
+	 * @param update - Set to true to rewrite golden files.
+	 */
+	void Assert::updateSnapshots(bool update) {
+		snapshotUpdate = update;
+	}
+
+	/**
+	 * Assert::compareSnapshot
+	 * -------------------
+	 * Compare (or, in update mode, write) one snapshot.
+	 * @param actual - The bytes to compare
+	 * @param size - The number of bytes to compare
+	 * @param goldenPath - The golden file to compare against
+	 */
+	bool Assert::compareSnapshot(const unsigned char* actual, size_t size, std::string goldenPath) {
+		MappedFile golden(goldenPath);
+		size_t firstMismatch = Compare::npos;
+		size_t mismatches = 0;
+
+		if(golden.isOpen()) {
+			size_t common = std::min(golden.size(), size);
+			mismatches = Compare::elements(golden.data(), actual, common, 1, &firstMismatch);
+
+			if(mismatches == 0 && golden.size() == size) {
+				return true;
+			}
+
+			if(firstMismatch == Compare::npos) {
+				firstMismatch = common;
+			}
+		}
+
+		if(snapshotUpdate) {
+			// The golden file must be unmapped before it can be replaced on Windows.
+			golden.close();
+
+			if(!File::writeAtomically(goldenPath, actual, size)) {
+				Print::line(ASSERT_OUTPUT + std::string("cannot write snapshot ") + goldenPath, GREY);
+				return false;
+			}
+
+			Print::line(ASSERT_OUTPUT + std::string("updated snapshot ") + goldenPath, GREY);
+			return true;
+		}
+
+		if(!golden.isOpen()) {
+			Print::line(ASSERT_OUTPUT + std::string("missing snapshot ") + goldenPath + " (set EARL_UPDATE_SNAPSHOTS=1 to create it)", GREY);
+			return false;
+		}
+
+		std::ostringstream summary;
+		summary << "snapshot " << goldenPath << " differs at offset " << firstMismatch;
+
+		if(mismatches > 0) {
+			summary << ", " << mismatches << " bytes differ";
+		}
+		if(golden.size() != size) {
+			summary << ", size " << golden.size() << " != " << size;
+		}
+
+		Print::line(ASSERT_OUTPUT + summary.str(), GREY);
+		printSnapshotDiff(golden, actual, size, firstMismatch, mismatches);
+		return false;
+	}
+
+	/**
+	 * Assert::printSnapshotDiff
+	 * -------------------
+	 * Print the lines around the first difference between a golden file
+	 * and the actual data, or a hex dump if the data is not text. Only
+	 * the region around the difference is read, so the lines are not
+	 * numbered.
+	 * @param golden - The mapped golden file
+	 * @param actual - The actual bytes
+	 * @param size - The number of actual bytes
+	 * @param offset - The offset of the first difference
+	 * @param mismatches - The number of differing bytes in the common prefix
+	 */
+	void Assert::printSnapshotDiff(const MappedFile& golden, const unsigned char* actual, size_t size, size_t offset, size_t mismatches) {
+		const unsigned char* sides[] = { golden.data(), actual };
+		const size_t sizes[] = { golden.size(), size };
+		const char* markers[] = { "-", "+" };
+		size_t start = offset;
+
+		// Find the start of the line holding the difference; the bytes
+		// before offset are identical on both sides.
+		while(start > 0 && offset - start < SNAPSHOT_LINE_SEARCH && sides[0][start - 1] != '\n') {
+			start--;
+		}
+
+		bool text = start == 0 || sides[0][start - 1] == '\n';
+
+		for(int side = 0; side < 2 && text; side++) {
+			size_t end = std::min(sizes[side], offset + SNAPSHOT_LINE_SEARCH);
+			text = start >= end || std::memchr(sides[side] + start, '\0', end - start) == nullptr;
+		}
+
+		if(!text) {
+			if(mismatches > 0) {
+				std::istringstream window(Compare::hexWindow(sides[0], sides[1], std::min(sizes[0], sizes[1]), offset));
+				std::string row;
+
+				while(std::getline(window, row)) {
+					Print::line(ASSERT_OUTPUT + row, GREY);
+				}
+			} else {
+				// One side is a prefix of the other, so there is no
+				// differing byte to show.
+				std::ostringstream row;
+				row << markers[0] << sizes[0] << " bytes, " << markers[1] << sizes[1] << " bytes, identical up to offset " << offset;
+				Print::line(ASSERT_OUTPUT + row.str(), GREY);
+			}
+			return;
+		}
+
+		for(int side = 0; side < 2; side++) {
+			size_t position = start;
+
+			for(int line = 0; line < SNAPSHOT_CONTEXT_LINES && position < sizes[side]; line++) {
+				const unsigned char* begin = sides[side] + position;
+				const void* newline = std::memchr(begin, '\n', sizes[side] - position);
+				size_t length = newline ? static_cast<const unsigned char*>(newline) - begin : sizes[side] - position;
+				std::ostringstream row;
+
+				row << markers[side] << " | "
+					<< std::string(reinterpret_cast<const char*>(begin), std::min<size_t>(length, SNAPSHOT_LINE_LIMIT));
+
+				if(length > SNAPSHOT_LINE_LIMIT) {
+					row << "...";
+				}
+
+				Print::line(ASSERT_OUTPUT + row.str(), GREY);
+				position += length + 1;
+			}
+		}
+	}
 };
\ No newline at end of file
@@ -29,10 +29,17 @@
  *******************************************************************************/ 
 #pragma once
 
+#include <cstddef>
 #include <string>
 #include <iostream>
 #include <mutex>
+#include <type_traits>
+#include <vector>
+#include "EarlCompare.h"
+#include "EarlFile.h"
 #include "EarlPrint.h"
+#include "EarlStress.h"
+#include "EarlUsage.h"
 
 #ifdef _MSC_VER
  	#define GREY ""
@@ -61,6 +68,49 @@ namespace Earl {
 			static bool isEqualDeep(T*, T*);
 			template< typename T>
 			static bool isEqualDeep(T*, T*, std::string);
+
+			static bool isEqualBuffer(const void*, const void*, size_t);
+			static bool isEqualBuffer(const void*, const void*, size_t, std::string);
+
+			template <typename T>
+			static bool isEqualArray(const T*, const T*, size_t);
+			template <typename T>
+			static bool isEqualArray(const T*, const T*, size_t, std::string);
+			template <typename T>
+			static bool isEqualArray(const std::vector<T>&, const std::vector<T>&);
+			template <typename T>
+			static bool isEqualArray(const std::vector<T>&, const std::vector<T>&, std::string);
+
+			static bool isNear(const float*, const float*, size_t, double, Tolerance = Tolerance::Absolute);
+			static bool isNear(const float*, const float*, size_t, double, Tolerance, std::string);
+			static bool isNear(const double*, const double*, size_t, double, Tolerance = Tolerance::Absolute);
+			static bool isNear(const double*, const double*, size_t, double, Tolerance, std::string);
+
+			template <typename T>
+			static bool isNear(const std::vector<T>&, const std::vector<T>&, double, Tolerance = Tolerance::Absolute);
+			template <typename T>
+			static bool isNear(const std::vector<T>&, const std::vector<T>&, double, Tolerance, std::string);
+
+			static bool matchesSnapshot(const void*, size_t, std::string);
+			static bool matchesSnapshot(const void*, size_t, std::string, std::string);
+			static bool matchesSnapshotFile(std::string, std::string);
+			static bool matchesSnapshotFile(std::string, std::string, std::string);
+			static void updateSnapshots(bool);
+
+			static bool hasEfficiency(const std::vector<ScalingStep>&, int, double);
+			static bool hasEfficiency(const std::vector<ScalingStep>&, int, double, std::string);
+
+			static bool isWithinMemory(size_t);
+			static bool isWithinMemory(size_t, std::string);
+
+		private:
+			// Whether snapshot assertions rewrite their golden files.
+			static bool snapshotUpdate;
+
+			static bool compareSnapshot(const unsigned char*, size_t, std::string);
+			static void printSnapshotDiff(const MappedFile&, const unsigned char*, size_t, size_t, size_t);
+			static void printMismatch(const void*, const void*, size_t, size_t, size_t, size_t);
+			static void printTolerance(const ToleranceReport&, size_t, double, Tolerance, double, double);
 	};
 
 	/**
@@ -119,4 +169,140 @@ namespace Earl {
 		Print::line(ASSERT_OUTPUT + outputMessage, GREY);
 		return isEqualDeep(first, second);
 	}
+
+	/**
+	 * Assert::isEqualArray
+	 * -------------------
+	 * Compare whether two arrays hold equal elements. Integral, enum
+	 * and pointer elements are compared with the vectorised byte kernels;
+	 * other types are compared element-wise with ==. On failure, the
+	 * first differing index and the number of differing elements are printed.
+	 * @param first - First array to compare
+	 * @param second - Second array to compare
+	 * @param count - Number of elements in each array
+	 */
+	template <typename T>
+	bool Assert::isEqualArray(const T* first, const T* second, size_t count) {
+		size_t firstMismatch = Compare::npos;
+		size_t mismatches = 0;
+
+		if(count == 0) {
+			return true;
+		}
+
+		if(!first || !second) {
+			return false;
+		}
+
+		if(std::is_integral<T>::value || std::is_enum<T>::value || std::is_pointer<T>::value) {
+			mismatches = Compare::elements(first, second, count, sizeof(T), &firstMismatch);
+
+			if(mismatches > 0) {
+				printMismatch(first, second, count, sizeof(T), firstMismatch, mismatches);
+			}
+		} else {
+			for(size_t i = 0; i < count; i++) {
+				if(!(first[i] == second[i])) {
+					if(firstMismatch == Compare::npos) {
+						firstMismatch = i;
+					}
+					mismatches++;
+				}
+			}
+
+			if(mismatches > 0) {
+				printMismatch(first, second, count, 0, firstMismatch, mismatches);
+			}
+		}
+
+		return mismatches == 0;
+	}
+
+	/**
+	 * Assert::isEqualArray
+	 * -------------------
+	 * Compare whether two arrays hold equal elements,
+	 * adding a comment to the assertion.
+	 * @param first - First array to compare
+	 * @param second - Second array to compare
+	 * @param count - Number of elements in each array
+	 * @param outputMessage - The comment to print when making the assertion
+	 */
+	template <typename T>
+	bool Assert::isEqualArray(const T* first, const T* second, size_t count, std::string outputMessage) {
+		Print::line(ASSERT_OUTPUT + outputMessage, GREY);
+		return isEqualArray(first, second, count);
+	}
+
+	/**
+	 * Assert::isEqualArray
+	 * -------------------
+	 * Compare whether two vectors are the same size and
+	 * hold equal elements.
+	 * @param first - First vector to compare
+	 * @param second - Second vector to compare
+	 */
+	template <typename T>
+	bool Assert::isEqualArray(const std::vector<T>& first, const std::vector<T>& second) {
+		if(first.size() != second.size()) {
+			Print::line(ASSERT_OUTPUT + std::string("sizes differ: ") + std::to_string(first.size()) +
+				" != " + std::to_string(second.size()), GREY);
+			return false;
+		}
+
+		return isEqualArray(first.data(), second.data(), first.size());
+	}
+
+	/**
+	 * Assert::isEqualArray
+	 * -------------------
+	 * Compare whether two vectors are the same size and hold
+	 * equal elements, adding a comment to the assertion.
+	 * @param first - First vector to compare
+	 * @param second - Second vector to compare
+	 * @param outputMessage - The comment to print when making the assertion
+	 */
+	template <typename T>
+	bool Assert::isEqualArray(const std::vector<T>& first, const std::vector<T>& second, std::string outputMessage) {
+		Print::line(ASSERT_OUTPUT + outputMessage, GREY);
+		return isEqualArray(first, second);
+	}
+
+	/**
+	 * Assert::isNear
+	 * -------------------
+	 * Compare whether two vectors are the same size and every
+	 * pair of values lies within tolerance.
+	 * @param first - First vector to compare
+	 * @param second - Second vector to compare
+	 * @param tolerance - The largest error allowed
+	 * @param mode - How the error is measured (defaults to absolute)
+	 */
+	template <typename T>
+	bool Assert::isNear(const std::vector<T>& first, const std::vector<T>& second, double tolerance, Tolerance mode) {
+		if(first.size() != second.size()) {
+			Print::line(ASSERT_OUTPUT + std::string("sizes differ: ") + std::to_string(first.size()) +
+				" != " + std::to_string(second.size()), GREY);
+			return false;
+		}
+
+		return isNear(first.data(), second.data(), first.size(), tolerance, mode);
+	}
+
+	/**
+	 * Assert::isNear
+	 * -------------------
+	 * Compare whether two vectors are the same size and every pair
+	 * of values lies within tolerance, adding a comment to the assertion.
+	 * @param first - First vector to compare
+	 * @param second - Second vector to compare
+	 * @param tolerance - The largest error allowed
+	 * @param mode - How the error is measured
+	 * @param outputMessage - The comment to print when making the assertion
+	 */
+	template <typename T>
+	bool Assert::isNear(const std::vector<T>& first, const std::vector<T>& second, double tolerance, Tolerance mode, std::string outputMessage) {
+		Print::line(ASSERT_OUTPUT + outputMessage, GREY);
+		return isNear(first, second, tolerance, mode);
+	}
 }
\ No newline at end of file
@@ -0,0 +1,597 @@
+/*******************************************************************************
+ * Copyright (c) 2014, Niall Frederick Weedon and other Contributors
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without modification, 
+ * are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, this 
+ * list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ * this list of conditions and the following disclaimer in the documentation and/or 
+ * other materials provided with the distribution.
+ * 
+ * 3. Neither the name of the copyright holder nor the names of its contributors may
+ * be used to endorse or promote products derived from this software without 
+ * specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE 
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE 
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL 
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR 
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, 
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE 
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *******************************************************************************/
+#include "EarlCompare.h"
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <iomanip>
+#include <limits>
+#include <sstream>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+	#define EARL_X86_DISPATCH
+	#define EARL_TARGET(isa) __attribute__((target(isa)))
+	#include <immintrin.h>
+#endif
+
+// Number of bytes shown per row of Compare::hexWindow.
+#define HEX_ROW 16
+
+namespace Earl {
+	const size_t Compare::npos;
+
+	typedef size_t (*MismatchKernel)(const uint8_t*, const uint8_t*, size_t, size_t, size_t*);
+
+	struct KernelEntry {
+		MismatchKernel run;
+		const char* name;
+	};
+
+	/**
+	 * mismatchScalar
+	 * -------------------
+	 * Count the differing elements in the index range [begin, end),
+	 * recording the first one found in firstMismatch.
+	 */
+	static size_t mismatchScalar(const uint8_t* first, const uint8_t* second, size_t begin, size_t end, size_t width, size_t* firstMismatch) {
+		size_t mismatches = 0;
+
+		for(size_t i = begin; i < end; i++) {
+			if(std::memcmp(first + i * width, second + i * width, width) != 0) {
+				if(*firstMismatch == Compare::npos) {
+					*firstMismatch = i;
+				}
+				mismatches++;
+			}
+		}
+
+		return mismatches;
+	}
+
+	static size_t mismatchPortable(const uint8_t* first, const uint8_t* second, size_t count, size_t width, size_t* firstMismatch) {
+		return mismatchScalar(first, second, 0, count, width, firstMismatch);
+	}
+
+#ifdef EARL_X86_DISPATCH
+	/**
+	 * accumulate
+	 * -------------------
+	 * Fold a per-byte mismatch mask (one bit per byte, starting at
+	 * byte offset) down to one bit per element, record the first
+	 * differing element and return the number of differing elements.
+	 */
+	static inline size_t accumulate(uint32_t mask, size_t offset, size_t width, size_t* firstMismatch) {
+		if(width >= 2) mask |= mask >> 1;
+		if(width >= 4) mask |= mask >> 2;
+		if(width >= 8) mask |= mask >> 4;
+		if(width >= 16) mask |= mask >> 8;
+
+		switch(width) {
+			case 2: mask &= 0x55555555u; break;
+			case 4: mask &= 0x11111111u; break;
+			case 8: mask &= 0x01010101u; break;
+			case 16: mask &= 0x00010001u; break;
+		}
+
+		if(mask == 0) {
+			return 0;
+		}
+
+		if(*firstMismatch == Compare::npos) {
+			*firstMismatch = (offset + __builtin_ctz(mask)) / width;
+		}
+
+		return __builtin_popcount(mask);
+	}
+
+	EARL_TARGET("sse2")
+	static size_t mismatchSse2(const uint8_t* first, const uint8_t* second, size_t count, size_t width, size_t* firstMismatch) {
+		const size_t bytes = count * width;
+		size_t mismatches = 0;
+		size_t i = 0;
+
+		for(; i + 16 <= bytes; i += 16) {
+			__m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(first + i));
+			__m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(second + i));
+			uint32_t mask = ~static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(a, b))) & 0xFFFFu;
+
+			if(mask != 0) {
+				mismatches += accumulate(mask, i, width, firstMismatch);
+			}
+		}
+
+		return mismatches + mismatchScalar(first, second, i / width, count, width, firstMismatch);
+	}
+
+	EARL_TARGET("avx2,popcnt")
+	static size_t mismatchAvx2(const uint8_t* first, const uint8_t* second, size_t count, size_t width, size_t* firstMismatch) {
+		const size_t bytes = count * width;
+		size_t mismatches = 0;
+		size_t i = 0;
+
+		// Compare two vectors per iteration, only decoding the masks
+		// when something in the 64 byte block differs.
+		for(; i + 64 <= bytes; i += 64) {
+			__m256i eq0 = _mm256_cmpeq_epi8(
+				_mm256_loadu_si256(reinterpret_cast<const __m256i*>(first + i)),
+				_mm256_loadu_si256(reinterpret_cast<const __m256i*>(second + i)));
+			__m256i eq1 = _mm256_cmpeq_epi8(
+				_mm256_loadu_si256(reinterpret_cast<const __m256i*>(first + i + 32)),
+				_mm256_loadu_si256(reinterpret_cast<const __m256i*>(second + i + 32)));
+
+			if(_mm256_movemask_epi8(_mm256_and_si256(eq0, eq1)) == -1) {
+				continue;
+			}
+
+			mismatches += accumulate(~static_cast<uint32_t>(_mm256_movemask_epi8(eq0)), i, width, firstMismatch);
+			mismatches += accumulate(~static_cast<uint32_t>(_mm256_movemask_epi8(eq1)), i + 32, width, firstMismatch);
+		}
+
+		for(; i + 32 <= bytes; i += 32) {
+			__m256i eq = _mm256_cmpeq_epi8(
+				_mm256_loadu_si256(reinterpret_cast<const __m256i*>(first + i)),
+				_mm256_loadu_si256(reinterpret_cast<const __m256i*>(second + i)));
+			uint32_t mask = ~static_cast<uint32_t>(_mm256_movemask_epi8(eq));
+
+			if(mask != 0) {
+				mismatches += accumulate(mask, i, width, firstMismatch);
+			}
+		}
+
+		return mismatches + mismatchScalar(first, second, i / width, count, width, firstMismatch);
+	}
+#endif
+
+#ifdef EARL_X86_DISPATCH
+	static bool hasAvx2() {
+		static const bool supported = (__builtin_cpu_init(), __builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt"));
+		return supported;
+	}
+#endif
+
+	/**
+	 * selectKernel
+	 * -------------------
+	 * Pick the widest comparison kernel the running CPU supports.
+	 */
+	static KernelEntry selectKernel() {
+		KernelEntry entry = { mismatchPortable, "scalar" };
+#ifdef EARL_X86_DISPATCH
+		if(hasAvx2()) {
+			entry.run = mismatchAvx2;
+			entry.name = "avx2";
+		} else if(__builtin_cpu_supports("sse2")) {
+			entry.run = mismatchSse2;
+			entry.name = "sse2";
+		}
+#endif
+		return entry;
+	}
+
+	static const KernelEntry& kernelEntry() {
+		static const KernelEntry entry = selectKernel();
+		return entry;
+	}
+
+	/**
+	 * Compare::elements
+	 * -------------------
+	 * Compare two ranges of fixed-width elements byte-for-byte using the
+	 * widest vector kernel supported by the running CPU.
+	 * @param first - First range to compare
+	 * @param second - Second range to compare
+	 * @param count - Number of elements in each range
+	 * @param width - Size of one element in bytes
+	 * @param firstMismatch - Receives the index of the first differing
+	 *						element, or Compare::npos.
+	 * @return The number of elements which differ.
+	 */
+	size_t Compare::elements(const void* first, const void* second, size_t count, size_t width, size_t* firstMismatch) {
+		const uint8_t* a = static_cast<const uint8_t*>(first);
+		const uint8_t* b = static_cast<const uint8_t*>(second);
+		*firstMismatch = npos;
+
+		if(count == 0 || width == 0 || a == b) {
+			return 0;
+		}
+
+		// The vector kernels fold byte masks into element masks, which
+		// only works for power-of-two widths that divide a vector.
+		if(width > 16 || (width & (width - 1)) != 0) {
+			return mismatchPortable(a, b, count, width, firstMismatch);
+		}
+
+		return kernelEntry().run(a, b, count, width, firstMismatch);
+	}
+
+	/**
+	 * Compare::hexWindow
+	 * -------------------
+	 * Format the bytes surrounding offset in both buffers as a hex
+	 * dump, with differing bytes marked underneath.
+	 * @param first - First buffer
+	 * @param second - Second buffer
+	 * @param size - Size of both buffers in bytes
+	 * @param offset - The byte offset to centre the window on
+	 * @return The dump, one newline-terminated line per row.
+	 */
+	std::string Compare::hexWindow(const void* first, const void* second, size_t size, size_t offset) {
+		const uint8_t* a = static_cast<const uint8_t*>(first);
+		const uint8_t* b = static_cast<const uint8_t*>(second);
+		std::ostringstream out;
+
+		if(offset >= size) {
+			return "";
+		}
+
+		size_t begin = (offset / HEX_ROW) * HEX_ROW;
+		begin = begin >= HEX_ROW ? begin - HEX_ROW : 0;
+		size_t end = (offset / HEX_ROW + 2) * HEX_ROW;
+		end = end < size ? end : size;
+
+		out << std::hex << std::setfill('0');
+
+		for(size_t row = begin; row < end; row += HEX_ROW) {
+			size_t rowEnd = row + HEX_ROW < end ? row + HEX_ROW : end;
+			std::string marks(16, ' ');
+
+			out << "first  " << std::setw(8) << row << " ";
+			for(size_t i = row; i < rowEnd; i++) {
+				out << " " << std::setw(2) << static_cast<unsigned>(a[i]);
+				marks += a[i] != b[i] ? " ^^" : "   ";
+			}
+
+			out << "\nsecond " << std::setw(8) << row << " ";
+			for(size_t i = row; i < rowEnd; i++) {
+				out << " " << std::setw(2) << static_cast<unsigned>(b[i]);
+			}
+
+			out << "\n";
+
+			// Only mark rows which contain a difference.
+			if(marks.find('^') != std::string::npos) {
+				out << marks.substr(0, marks.find_last_not_of(' ') + 1) << "\n";
+			}
+		}
+
+		return out.str();
+	}
+
+	/**
+	 * orderedKey
+	 * -------------------
+	 * Map the bits of a float onto an integer that is ordered the same
+	 * way as the float, so that the difference between two keys is the
+	 * number of representable values between them.
+	 */
+	static inline int64_t orderedKey(float value) {
+		int32_t bits;
+		std::memcpy(&bits, &value, sizeof(bits));
+		return bits >= 0 ? bits : static_cast<int64_t>(INT32_MIN) - bits;
+	}
+
+	static inline int64_t orderedKey(double value) {
+		int64_t bits;
+		std::memcpy(&bits, &value, sizeof(bits));
+		return bits >= 0 ? bits : INT64_MIN - bits;
+	}
+
+	template <typename T>
+	static inline uint64_t ulpDistance(T first, T second) {
+		uint64_t a = static_cast<uint64_t>(orderedKey(first));
+		uint64_t b = static_cast<uint64_t>(orderedKey(second));
+		return orderedKey(first) > orderedKey(second) ? a - b : b - a;
+	}
+
+	static uint64_t maxUlps(double tolerance) {
+		if(!(tolerance >= 0)) {
+			return 0;
+		}
+		if(tolerance >= 18446744073709551615.0) {
+			return UINT64_MAX;
+		}
+		return static_cast<uint64_t>(tolerance);
+	}
+
+	/**
+	 * nearElement
+	 * -------------------
+	 * Check one pair of values against the tolerance. The arithmetic is
+	 * done in T so that it matches the vector kernels exactly.
+	 * @param error - Receives the measured error.
+	 */
+	template <typename T>
+	static inline bool nearElement(T first, T second, T tolerance, uint64_t ulps, Tolerance mode, double* error) {
+		bool firstNaN = first != first;
+		bool secondNaN = second != second;
+
+		if(firstNaN || secondNaN) {
+			*error = firstNaN && secondNaN ? 0 : std::numeric_limits<double>::infinity();
+			return firstNaN && secondNaN;
+		}
+
+		if(first == second) {
+			*error = 0;
+			return true;
+		}
+
+		T diff = std::fabs(first - second);
+
+		switch(mode) {
+			case Tolerance::Relative: {
+				T scale = std::fabs(first) > std::fabs(second) ? std::fabs(first) : std::fabs(second);
+				*error = static_cast<double>(diff) / scale;
+				return diff <= tolerance * scale;
+			}
+			case Tolerance::Ulp: {
+				uint64_t distance = ulpDistance(first, second);
+				*error = static_cast<double>(distance);
+				return distance <= ulps;
+			}
+			default:
+				*error = diff;
+				return diff <= tolerance;
+		}
+	}
+
+	template <typename T>
+	static bool nearScalar(const T* first, const T* second, size_t begin, size_t end, double tolerance, Tolerance mode) {
+		const T limit = static_cast<T>(tolerance);
+		const uint64_t ulps = maxUlps(tolerance);
+		double error;
+
+		for(size_t i = begin; i < end; i++) {
+			if(!nearElement(first[i], second[i], limit, ulps, mode, &error)) {
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+#ifdef EARL_X86_DISPATCH
+	/**
+	 * nearAvx2
+	 * -------------------
+	 * Vector check of whole blocks of values from begin, stopping at
+	 * the first block containing a value outside tolerance. NaNs and
+	 * infinities always fail here and are settled by nearScalar, so a
+	 * block passing here always passes there too.
+	 * @return The start of the first failing block, or the end of the
+	 *		   last whole block if every block passed.
+	 */
+	EARL_TARGET("avx2")
+	static size_t nearAvx2(const float* first, const float* second, size_t begin, size_t count, double tolerance, Tolerance mode) {
+		const __m256 absMask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7FFFFFFF));
+		const __m256 limit = _mm256_set1_ps(static_cast<float>(tolerance));
+		const uint64_t ulps = maxUlps(tolerance);
+		const __m256i ulpLimit = _mm256_set1_epi32(static_cast<int32_t>(ulps > UINT32_MAX ? UINT32_MAX : ulps));
+		const __m256i signBit = _mm256_set1_epi32(INT32_MIN);
+		size_t i = begin;
+
+		for(; i + 8 <= count; i += 8) {
+			__m256 a = _mm256_loadu_ps(first + i);
+			__m256 b = _mm256_loadu_ps(second + i);
+			int passed;
+
+			if(mode == Tolerance::Ulp) {
+				__m256i ia = _mm256_castps_si256(a);
+				__m256i ib = _mm256_castps_si256(b);
+				__m256i ka = _mm256_blendv_epi8(ia, _mm256_sub_epi32(signBit, ia), _mm256_srai_epi32(ia, 31));
+				__m256i kb = _mm256_blendv_epi8(ib, _mm256_sub_epi32(signBit, ib), _mm256_srai_epi32(ib, 31));
+				__m256i distance = _mm256_sub_epi32(_mm256_max_epi32(ka, kb), _mm256_min_epi32(ka, kb));
+				__m256i within = _mm256_cmpeq_epi32(_mm256_max_epu32(distance, ulpLimit), ulpLimit);
+				// NaNs must fall through to the scalar check.
+				__m256 ordered = _mm256_cmp_ps(a, b, _CMP_ORD_Q);
+				passed = _mm256_movemask_ps(_mm256_and_ps(_mm256_castsi256_ps(within), ordered));
+			} else {
+				__m256 diff = _mm256_and_ps(_mm256_sub_ps(a, b), absMask);
+				__m256 bound = limit;
+
+				if(mode == Tolerance::Relative) {
+					bound = _mm256_mul_ps(limit, _mm256_max_ps(_mm256_and_ps(a, absMask), _mm256_and_ps(b, absMask)));
+				}
+				passed = _mm256_movemask_ps(_mm256_cmp_ps(diff, bound, _CMP_LE_OQ));
+			}
+
+			if(passed != 0xFF) {
+				return i;
+			}
+		}
+
+		return i;
+	}
+
+	EARL_TARGET("avx2")
+	static size_t nearAvx2(const double* first, const double* second, size_t begin, size_t count, double tolerance, Tolerance mode) {
+		const __m256d absMask = _mm256_castsi256_pd(_mm256_set1_epi64x(INT64_MAX));
+		const __m256d limit = _mm256_set1_pd(tolerance);
+		const __m256i ulpLimit = _mm256_set1_epi64x(static_cast<int64_t>(maxUlps(tolerance) ^ 0x8000000000000000ull));
+		const __m256i signBit = _mm256_set1_epi64x(INT64_MIN);
+		const __m256i zero = _mm256_setzero_si256();
+		size_t i = begin;
+
+		for(; i + 4 <= count; i += 4) {
+			__m256d a = _mm256_loadu_pd(first + i);
+			__m256d b = _mm256_loadu_pd(second + i);
+			int passed;
+
+			if(mode == Tolerance::Ulp) {
+				__m256i ia = _mm256_castpd_si256(a);
+				__m256i ib = _mm256_castpd_si256(b);
+				__m256i ka = _mm256_blendv_epi8(ia, _mm256_sub_epi64(signBit, ia), _mm256_cmpgt_epi64(zero, ia));
+				__m256i kb = _mm256_blendv_epi8(ib, _mm256_sub_epi64(signBit, ib), _mm256_cmpgt_epi64(zero, ib));
+				__m256i greater = _mm256_cmpgt_epi64(ka, kb);
+				__m256i distance = _mm256_sub_epi64(_mm256_blendv_epi8(kb, ka, greater), _mm256_blendv_epi8(ka, kb, greater));
+				// Unsigned distance > limit, compared as signed by flipping the sign bits.
+				__m256i over = _mm256_cmpgt_epi64(_mm256_xor_si256(distance, signBit), ulpLimit);
+				__m256d ordered = _mm256_cmp_pd(a, b, _CMP_ORD_Q);
+				passed = _mm256_movemask_pd(_mm256_andnot_pd(_mm256_castsi256_pd(over), ordered));
+			} else {
+				__m256d diff = _mm256_and_pd(_mm256_sub_pd(a, b), absMask);
+				__m256d bound = limit;
+
+				if(mode == Tolerance::Relative) {
+					bound = _mm256_mul_pd(limit, _mm256_max_pd(_mm256_and_pd(a, absMask), _mm256_and_pd(b, absMask)));
+				}
+				passed = _mm256_movemask_pd(_mm256_cmp_pd(diff, bound, _CMP_LE_OQ));
+			}
+
+			if(passed != 0xF) {
+				return i;
+			}
+		}
+
+		return i;
+	}
+#endif
+
+	template <typename T>
+	static bool nearDispatch(const T* first, const T* second, size_t count, double tolerance, Tolerance mode) {
+		size_t checked = 0;
+
+		if(count == 0 || first == second) {
+			return true;
+		}
+
+#ifdef EARL_X86_DISPATCH
+		if(hasAvx2()) {
+			const size_t width = 32 / sizeof(T);
+
+			while(true) {
+				checked = nearAvx2(first, second, checked, count, tolerance, mode);
+
+				if(checked + width > count) {
+					break;
+				}
+
+				// A failing block may only hold NaNs or infinities which
+				// compare equal, so let the scalar check settle that block
+				// and carry on after it.
+				if(!nearScalar(first, second, checked, checked + width, tolerance, mode)) {
+					return false;
+				}
+
+				checked += width;
+			}
+		}
+#endif
+		return nearScalar(first, second, checked, count, tolerance, mode);
+	}
+
+	template <typename T>
+	static ToleranceReport toleranceReport(const T* first, const T* second, size_t count, double tolerance, Tolerance mode) {
+		const T limit = static_cast<T>(tolerance);
+		const uint64_t ulps = maxUlps(tolerance);
+		ToleranceReport report;
+		double error;
+
+		std::memset(&report, 0, sizeof(report));
+		report.maxIndex = Compare::npos;
+
+		for(size_t i = 0; i < count; i++) {
+			bool passed = nearElement(first[i], second[i], limit, ulps, mode, &error);
+
+			if(report.maxIndex == Compare::npos || error > report.maxError) {
+				report.maxIndex = i;
+				report.maxError = error;
+			}
+
+			if(passed) {
+				report.histogram[0]++;
+				continue;
+			}
+
+			report.failures++;
+
+			if(first[i] != first[i] || second[i] != second[i]) {
+				report.histogram[5]++;
+			} else if(error <= tolerance * 10) {
+				report.histogram[1]++;
+			} else if(error <= tolerance * 100) {
+				report.histogram[2]++;
+			} else if(error <= tolerance * 1000) {
+				report.histogram[3]++;
+			} else {
+				report.histogram[4]++;
+			}
+		}
+
+		return report;
+	}
+
+	/**
+	 * Compare::near
+	 * -------------------
+	 * Check whether every pair of values lies within tolerance, using
+	 * AVX2 where available. Two NaNs are considered equal.
+	 * @param first - First array to compare
+	 * @param second - Second array to compare
+	 * @param count - Number of values in each array
+	 * @param tolerance - The largest error allowed
+	 * @param mode - How the error is measured
+	 */
+	bool Compare::near(const float* first, const float* second, size_t count, double tolerance, Tolerance mode) {
+		return nearDispatch(first, second, count, tolerance, mode);
+	}
+
+	bool Compare::near(const double* first, const double* second, size_t count, double tolerance, Tolerance mode) {
+		return nearDispatch(first, second, count, tolerance, mode);
+	}
+
+	/**
+	 * Compare::tolerance
+	 * -------------------
+	 * Measure the error of every pair of values, for diagnosing
+	 * a failed Compare::near.
+	 * @param first - First array to compare
+	 * @param second - Second array to compare
+	 * @param count - Number of values in each array
+	 * @param tolerance - The largest error allowed
+	 * @param mode - How the error is measured
+	 */
+	ToleranceReport Compare::tolerance(const float* first, const float* second, size_t count, double tolerance, Tolerance mode) {
+		return toleranceReport(first, second, count, tolerance, mode);
+	}
+
+	ToleranceReport Compare::tolerance(const double* first, const double* second, size_t count, double tolerance, Tolerance mode) {
+		return toleranceReport(first, second, count, tolerance, mode);
+	}
+
+	/**
+	 * Compare::kernel
+	 * -------------------
+	 * Returns the name of the comparison kernel selected
+	 * for this CPU ("avx2", "sse2" or "scalar").
+	 */
+	std::string Compare::kernel() {
+		return kernelEntry().name;
+	}
+};
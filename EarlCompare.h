@@ -0,0 +1,130 @@
+/*******************************************************************************
+ * Copyright (c) 2014, Niall Frederick Weedon and other Contributors
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without modification, 
+ * are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, this 
+ * list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ * this list of conditions and the following disclaimer in the documentation and/or 
+ * other materials provided with the distribution.
+ * 
+ * 3. Neither the name of the copyright holder nor the names of its contributors may
+ * be used to endorse or promote products derived from this software without 
+ * specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE 
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE 
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL 
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR 
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, 
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE 
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *******************************************************************************/
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+// Number of buckets in ToleranceReport::histogram.
+#define TOLERANCE_BUCKETS 6
+
+namespace Earl {
+	// How Compare::near measures the error between two values.
+	enum class Tolerance {
+		// |first - second|
+		Absolute,
+		// |first - second| / max(|first|, |second|)
+		Relative,
+		// Number of representable values between first and second.
+		Ulp
+	};
+
+	struct ToleranceReport {
+		// Number of elements outside the tolerance.
+		size_t failures;
+		// Index and size of the largest error. Mismatched NaNs
+		// count as an infinite error.
+		size_t maxIndex;
+		double maxError;
+		// Elements bucketed by error relative to the tolerance:
+		// within, <= 10x, <= 100x, <= 1000x, > 1000x and NaN mismatches.
+		size_t histogram[TOLERANCE_BUCKETS];
+	};
+
+	class Compare {
+	public:
+		// Returned as the mismatch index when two ranges are equal.
+		static const size_t npos = static_cast<size_t>(-1);
+
+		/**
+		 * Compare::elements
+		 * -------------------
+		 * Compare two ranges of fixed-width elements byte-for-byte using the
+		 * widest vector kernel supported by the running CPU.
+		 * @param first - First range to compare
+		 * @param second - Second range to compare
+		 * @param count - Number of elements in each range
+		 * @param width - Size of one element in bytes
+		 * @param firstMismatch - Receives the index of the first differing
+		 *						element, or Compare::npos.
+		 * @return The number of elements which differ.
+		 */
+		static size_t elements(const void*, const void*, size_t, size_t, size_t*);
+
+		/**
+		 * Compare::hexWindow
+		 * -------------------
+		 * Format the bytes surrounding offset in both buffers as a hex
+		 * dump, with differing bytes marked underneath.
+		 * @param first - First buffer
+		 * @param second - Second buffer
+		 * @param size - Size of both buffers in bytes
+		 * @param offset - The byte offset to centre the window on
+		 * @return The dump, one newline-terminated line per row.
+		 */
+		static std::string hexWindow(const void*, const void*, size_t, size_t);
+
+		/**
+		 * Compare::near
+		 * -------------------
+		 * Check whether every pair of values lies within tolerance, using
+		 * AVX2 where available. Two NaNs are considered equal.
+		 * @param first - First array to compare
+		 * @param second - Second array to compare
+		 * @param count - Number of values in each array
+		 * @param tolerance - The largest error allowed
+		 * @param mode - How the error is measured
+		 */
+		static bool near(const float*, const float*, size_t, double, Tolerance);
+		static bool near(const double*, const double*, size_t, double, Tolerance);
+
+		/**
+		 * Compare::tolerance
+		 * -------------------
+		 * Measure the error of every pair of values, for diagnosing
+		 * a failed Compare::near.
+		 * @param first - First array to compare
+		 * @param second - Second array to compare
+		 * @param count - Number of values in each array
+		 * @param tolerance - The largest error allowed
+		 * @param mode - How the error is measured
+		 */
+		static ToleranceReport tolerance(const float*, const float*, size_t, double, Tolerance);
+		static ToleranceReport tolerance(const double*, const double*, size_t, double, Tolerance);
+
+		/**
+		 * Compare::kernel
+		 * -------------------
+		 * Returns the name of the comparison kernel selected
+		 * for this CPU ("avx2", "sse2" or "scalar").
+		 */
+		static std::string kernel();
+	};
+};
@@ -0,0 +1,312 @@
+/*******************************************************************************
+ * Copyright (c) 2014, Niall Frederick Weedon and other Contributors
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without modification, 
+ * are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, this 
+ * list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ * this list of conditions and the following disclaimer in the documentation and/or 
+ * other materials provided with the distribution.
+ * 
+ * 3. Neither the name of the copyright holder nor the names of its contributors may
+ * be used to endorse or promote products derived from this software without 
+ * specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE 
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE 
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL 
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR 
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, 
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE 
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *******************************************************************************/
+#include "EarlFile.h"
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <sstream>
+
+#ifdef _WIN32
+	#include <windows.h>
+	#include <process.h>
+#else
+	#ifdef __APPLE__
+		#include <mach-o/dyld.h>
+	#endif
+	#include <fcntl.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <unistd.h>
+#endif
+
+namespace Earl {
+	// Numbers the temporary files of File::writeAtomically, so that
+	// threads replacing the same file do not share one.
+	static std::atomic<unsigned> temporaryFiles(0);
+
+	MappedFile::MappedFile() : bytes(nullptr), length(0), opened(false) {
+#ifdef _WIN32
+		fileHandle = INVALID_HANDLE_VALUE;
+		mappingHandle = nullptr;
+#else
+		fd = -1;
+#endif
+	}
+
+	MappedFile::MappedFile(const std::string& path) : bytes(nullptr), length(0), opened(false) {
+#ifdef _WIN32
+		fileHandle = INVALID_HANDLE_VALUE;
+		mappingHandle = nullptr;
+#else
+		fd = -1;
+#endif
+		open(path);
+	}
+
+	MappedFile::~MappedFile() {
+		close();
+	}
+
+	/**
+	 * MappedFile::open
+	 * -------------------
+	 * Map the file at path, unmapping any file previously opened.
+	 * @param path - The file to map
+	 * @return Whether the file could be opened.
+	 */
+	bool MappedFile::open(const std::string& path) {
+		close();
+
+#ifdef _WIN32
+		LARGE_INTEGER fileSize;
+		fileHandle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+
+		if(fileHandle == INVALID_HANDLE_VALUE || !GetFileSizeEx(fileHandle, &fileSize)) {
+			close();
+			return false;
+		}
+
+		length = static_cast<size_t>(fileSize.QuadPart);
+		opened = true;
+
+		// Empty files cannot be mapped, but are still valid to compare.
+		if(length > 0) {
+			mappingHandle = CreateFileMappingA(fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+			bytes = mappingHandle ? static_cast<const unsigned char*>(MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0)) : nullptr;
+
+			if(!bytes) {
+				close();
+				return false;
+			}
+		}
+#else
+		struct stat info;
+		fd = ::open(path.c_str(), O_RDONLY);
+
+		if(fd < 0 || fstat(fd, &info) != 0) {
+			close();
+			return false;
+		}
+
+		length = static_cast<size_t>(info.st_size);
+		opened = true;
+
+		// Empty files cannot be mapped, but are still valid to compare.
+		if(length > 0) {
+			void* mapping = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+
+			if(mapping == MAP_FAILED) {
+				close();
+				return false;
+			}
+
+			// Comparisons read the file front to back.
+			madvise(mapping, length, MADV_SEQUENTIAL);
+			bytes = static_cast<const unsigned char*>(mapping);
+		}
+#endif
+		return true;
+	}
+
+	/**
+	 * MappedFile::close
+	 * -------------------
+	 * Unmap the file, if one is open.
+	 */
+	void MappedFile::close() {
+#ifdef _WIN32
+		if(bytes) {
+			UnmapViewOfFile(bytes);
+		}
+		if(mappingHandle) {
+			CloseHandle(mappingHandle);
+		}
+		if(fileHandle != INVALID_HANDLE_VALUE) {
+			CloseHandle(fileHandle);
+		}
+		mappingHandle = nullptr;
+		fileHandle = INVALID_HANDLE_VALUE;
+#else
+		if(bytes) {
+			munmap(const_cast<unsigned char*>(bytes), length);
+		}
+		if(fd >= 0) {
+			::close(fd);
+		}
+		fd = -1;
+#endif
+		bytes = nullptr;
+		length = 0;
+		opened = false;
+	}
+
+	/**
+	 * File::exists
+	 * -------------------
+	 * Returns whether a file exists at path.
+	 */
+	bool File::exists(const std::string& path) {
+#ifdef _WIN32
+		return GetFileAttributesA(path.c_str()) != INVALID_FILE_ATTRIBUTES;
+#else
+		struct stat info;
+		return stat(path.c_str(), &info) == 0;
+#endif
+	}
+
+	/**
+	 * File::makeDirectory
+	 * -------------------
+	 * Create a directory at path, if one does not exist.
+	 * @return Whether the directory exists now.
+	 */
+	bool File::makeDirectory(const std::string& path) {
+#ifdef _WIN32
+		return CreateDirectoryA(path.c_str(), nullptr) || GetLastError() == ERROR_ALREADY_EXISTS;
+#else
+		return mkdir(path.c_str(), 0755) == 0 || errno == EEXIST;
+#endif
+	}
+
+	/**
+	 * File::writeAtomically
+	 * -------------------
+	 * Replace the file at path with data. The data is written to a
+	 * temporary file beside it, flushed and renamed over the target, so
+	 * readers see either the old contents or the new ones. A file which
+	 * is replaced keeps its mode.
+	 * @param path - The file to write
+	 * @param data - The bytes to write
+	 * @param size - The number of bytes to write
+	 * @return Whether the file was replaced.
+	 */
+	bool File::writeAtomically(const std::string& path, const void* data, size_t size) {
+		const char* bytes = static_cast<const char*>(data);
+		std::ostringstream temporary;
+
+#ifdef _WIN32
+		temporary << path << ".tmp." << _getpid() << "." << temporaryFiles++;
+		FILE* out = std::fopen(temporary.str().c_str(), "wb");
+
+		if(!out) {
+			return false;
+		}
+
+		bool written = std::fwrite(bytes, 1, size, out) == size;
+		written &= std::fflush(out) == 0;
+		std::fclose(out);
+
+		if(!written || !MoveFileExA(temporary.str().c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH)) {
+			std::remove(temporary.str().c_str());
+			return false;
+		}
+#else
+		temporary << path << ".tmp." << getpid() << "." << temporaryFiles++;
+		// A file being replaced keeps its mode.
+		struct stat existing;
+		bool replacing = stat(path.c_str(), &existing) == 0;
+		int out = ::open(temporary.str().c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+
+		if(out < 0) {
+			return false;
+		}
+
+		if(replacing) {
+			fchmod(out, existing.st_mode & 07777);
+		}
+
+		while(size > 0) {
+			ssize_t count = write(out, bytes, size);
+
+			if(count < 0) {
+				if(errno == EINTR) {
+					continue;
+				}
+				break;
+			}
+
+			bytes += count;
+			size -= static_cast<size_t>(count);
+		}
+
+		bool written = size == 0 && fsync(out) == 0;
+		written &= ::close(out) == 0;
+
+		if(!written || rename(temporary.str().c_str(), path.c_str()) != 0) {
+			std::remove(temporary.str().c_str());
+			return false;
+		}
+#endif
+		return true;
+	}
+
+	/**
+	 * File::hash
+	 * -------------------
+	 * Hash a block of bytes with 64-bit FNV-1a. Pass a previous
+	 * result as seed to hash several blocks as one.
+	 * @param data - The bytes to hash
+	 * @param size - The number of bytes to hash
+	 * @param seed - The hash to continue from
+	 */
+	uint64_t File::hash(const void* data, size_t size, uint64_t seed) {
+		const unsigned char* bytes = static_cast<const unsigned char*>(data);
+
+		for(size_t i = 0; i < size; i++) {
+			seed = (seed ^ bytes[i]) * 1099511628211ull;
+		}
+
+		return seed;
+	}
+
+	/**
+	 * File::executablePath
+	 * -------------------
+	 * Returns the path of the running executable, or an
+	 * empty string if it cannot be determined.
+	 */
+	std::string File::executablePath() {
+#ifdef _WIN32
+		char path[MAX_PATH];
+		DWORD length = GetModuleFileNameA(nullptr, path, MAX_PATH);
+		return length > 0 && length < MAX_PATH ? std::string(path, length) : "";
+#elif defined(__linux__)
+		char path[4096];
+		ssize_t length = readlink("/proc/self/exe", path, sizeof(path));
+		return length > 0 && static_cast<size_t>(length) < sizeof(path) ? std::string(path, length) : "";
+#elif defined(__APPLE__)
+		char path[4096];
+		uint32_t length = sizeof(path);
+		return _NSGetExecutablePath(path, &length) == 0 ? std::string(path) : "";
+#else
+		return "";
+#endif
+	}
+};
\ No newline at end of file
@@ -0,0 +1,133 @@
+/*******************************************************************************
+ * Copyright (c) 2014, Niall Frederick Weedon and other Contributors
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without modification, 
+ * are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, this 
+ * list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ * this list of conditions and the following disclaimer in the documentation and/or 
+ * other materials provided with the distribution.
+ * 
+ * 3. Neither the name of the copyright holder nor the names of its contributors may
+ * be used to endorse or promote products derived from this software without 
+ * specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE 
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE 
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL 
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR 
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, 
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE 
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *******************************************************************************/
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace Earl {
+	/**
+	 * MappedFile
+	 * -------------------
+	 * A read-only memory mapping of a whole file, so large files can be
+	 * compared in place rather than read into memory first.
+	 */
+	class MappedFile {
+	private:
+		const unsigned char* bytes;
+		size_t length;
+		bool opened;
+#ifdef _WIN32
+		void* fileHandle;
+		void* mappingHandle;
+#else
+		int fd;
+#endif
+
+		MappedFile(const MappedFile&);
+		MappedFile& operator=(const MappedFile&);
+	public:
+		MappedFile();
+		explicit MappedFile(const std::string&);
+		~MappedFile();
+
+		/**
+		 * MappedFile::open
+		 * -------------------
+		 * Map the file at path, unmapping any file previously opened.
+		 * @param path - The file to map
+		 * @return Whether the file could be opened.
+		 */
+		bool open(const std::string&);
+
+		/**
+		 * MappedFile::close
+		 * -------------------
+		 * Unmap the file, if one is open.
+		 */
+		void close();
+
+		bool isOpen() const { return opened; };
+		const unsigned char* data() const { return bytes; };
+		size_t size() const { return length; };
+	};
+
+	class File {
+	public:
+		/**
+		 * File::exists
+		 * -------------------
+		 * Returns whether a file exists at path.
+		 */
+		static bool exists(const std::string&);
+
+		/**
+		 * File::makeDirectory
+		 * -------------------
+		 * Create a directory at path, if one does not exist.
+		 * @return Whether the directory exists now.
+		 */
+		static bool makeDirectory(const std::string&);
+
+		/**
+		 * File::writeAtomically
+		 * -------------------
+		 * Replace the file at path with data. The data is written to a
+		 * temporary file beside it, flushed and renamed over the target, so
+		 * readers see either the old contents or the new ones. A file which
+		 * is replaced keeps its mode.
+		 * @param path - The file to write
+		 * @param data - The bytes to write
+		 * @param size - The number of bytes to write
+		 * @return Whether the file was replaced.
+		 */
+		static bool writeAtomically(const std::string&, const void*, size_t);
+
+		/**
+		 * File::hash
+		 * -------------------
+		 * Hash a block of bytes with 64-bit FNV-1a. Pass a previous
+		 * result as seed to hash several blocks as one.
+		 * @param data - The bytes to hash
+		 * @param size - The number of bytes to hash
+		 * @param seed - The hash to continue from
+		 */
+		static uint64_t hash(const void*, size_t, uint64_t = 14695981039346656037ull);
+
+		/**
+		 * File::executablePath
+		 * -------------------
+		 * Returns the path of the running executable, or an
+		 * empty string if it cannot be determined.
+		 */
+		static std::string executablePath();
+	};
+};
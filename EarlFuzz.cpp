@@ -0,0 +1,728 @@
+/*******************************************************************************
+ * Copyright (c) 2014, Niall Frederick Weedon and other Contributors
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without modification, 
+ * are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, this 
+ * list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ * this list of conditions and the following disclaimer in the documentation and/or 
+ * other materials provided with the distribution.
+ * 
+ * 3. Neither the name of the copyright holder nor the names of its contributors may
+ * be used to endorse or promote products derived from this software without 
+ * specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE 
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE 
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL 
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR 
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, 
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE 
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *******************************************************************************/
+#include "EarlFuzz.h"
+#include "EarlFile.h"
+#include "EarlPrint.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+	#include <windows.h>
+#else
+	#include <dirent.h>
+	#include <fcntl.h>
+	#include <sys/mman.h>
+	#include <sys/wait.h>
+	#include <unistd.h>
+#endif
+
+namespace Earl {
+	// The calling thread's coverage map, or null when it is not fuzzing.
+	static thread_local uint8_t* coverageMap = nullptr;
+	// The number of trace-pc-guard guards handed out so far.
+	static uint32_t guardCount = 0;
+
+	// The input the calling thread is running, for the crash handler.
+	static thread_local const char* crashInput = nullptr;
+	static thread_local size_t crashLength = 0;
+	// Where the crash handler saves the input, or empty.
+	static char crashPath[4096];
+	// Set by the first crash, so that threads crashing together
+	// do not interleave their inputs in one file.
+	static std::atomic_flag crashSaved = ATOMIC_FLAG_INIT;
+};
+
+// Hooks called by code built with -fsanitize-coverage. Earl itself is
+// built without it, so that these are never instrumented. They are weak,
+// so that libFuzzer or a sanitizer runtime linked into the same binary
+// takes precedence rather than clashing; Earl then sees no coverage.
+#ifdef __GNUC__
+	#define EARL_WEAK __attribute__((weak))
+#else
+	#define EARL_WEAK
+#endif
+
+extern "C" {
+	EARL_WEAK void __sanitizer_cov_trace_pc_guard_init(uint32_t* start, uint32_t* stop) {
+		for(uint32_t* guard = start; guard < stop; guard++) {
+			if(*guard == 0) {
+				*guard = ++Earl::guardCount;
+			}
+		}
+	}
+
+	EARL_WEAK void __sanitizer_cov_trace_pc_guard(uint32_t* guard) {
+		uint8_t* map = Earl::coverageMap;
+
+		if(map != nullptr && *guard != 0) {
+			map[*guard % FUZZ_MAP_SIZE]++;
+		}
+	}
+
+#ifdef __GNUC__
+	EARL_WEAK void __sanitizer_cov_trace_pc() {
+		uint8_t* map = Earl::coverageMap;
+
+		if(map != nullptr) {
+			uintptr_t pc = reinterpret_cast<uintptr_t>(__builtin_return_address(0));
+			map[(pc ^ (pc >> 16)) % FUZZ_MAP_SIZE]++;
+		}
+	}
+#endif
+};
+
+namespace Earl {
+	// The signals treated as a crash of the target.
+	static const int crashSignals[] = { SIGSEGV, SIGFPE, SIGILL, SIGABRT
+#ifndef _WIN32
+		, SIGBUS
+#endif
+	};
+
+	/**
+	 * onCrash
+	 * -------------------
+	 * Save the crashing thread's input, then let the signal take
+	 * its usual course.
+	 */
+	static void onCrash(int signal) {
+#ifndef _WIN32
+		if(crashPath[0] != '\0' && crashInput != nullptr && !crashSaved.test_and_set()) {
+			int fd = open(crashPath, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+
+			if(fd >= 0) {
+				ssize_t written = write(fd, crashInput, crashLength);
+				(void) written;
+				close(fd);
+			}
+		}
+#endif
+		std::signal(signal, SIG_DFL);
+		std::raise(signal);
+	}
+
+	/**
+	 * xorshift
+	 * -------------------
+	 * Advance a xorshift64 generator and return its next value.
+	 */
+	static uint64_t xorshift(uint64_t& state) {
+		state ^= state << 13;
+		state ^= state >> 7;
+		state ^= state << 17;
+		return state;
+	}
+
+	/**
+	 * bucket
+	 * -------------------
+	 * Returns the bit standing for a range of hit counts, so that
+	 * running an edge more times only counts as new coverage when
+	 * the count moves to another range.
+	 */
+	static uint8_t bucket(uint8_t count) {
+		if(count >= 128) return 128;
+		if(count >= 32) return 64;
+		if(count >= 16) return 32;
+		if(count >= 8) return 16;
+		if(count >= 4) return 8;
+		return static_cast<uint8_t>(count == 3 ? 4 : count);
+	}
+
+	/**
+	 * execute
+	 * -------------------
+	 * Run target on input, treating an exception as a failure.
+	 */
+	static bool execute(const FuzzTarget& target, const std::string& input) {
+		try {
+			return target(reinterpret_cast<const uint8_t*>(input.data()), input.size());
+		} catch(...) {
+			return false;
+		}
+	}
+
+	/**
+	 * mutate
+	 * -------------------
+	 * Apply a few random mutations to data, possibly splicing
+	 * in part of partner.
+	 */
+	static void mutate(std::string& data, uint64_t& state, const std::string& partner) {
+		static const uint8_t interesting[] = { 0, 1, 0x7f, 0x80, 0xff };
+		int mutations = 1 + static_cast<int>(xorshift(state) % 4);
+
+		for(int i = 0; i < mutations; i++) {
+			size_t position = data.empty() ? 0 : xorshift(state) % data.size();
+
+			switch(xorshift(state) % 7) {
+			case 0:
+				if(!data.empty()) {
+					data[position] ^= static_cast<char>(1 << (xorshift(state) % 8));
+				}
+				break;
+			case 1:
+				if(!data.empty()) {
+					data[position] = static_cast<char>(xorshift(state));
+				}
+				break;
+			case 2:
+				if(data.size() < FUZZ_MAX_LENGTH) {
+					data.insert(data.begin() + (data.empty() ? 0 : xorshift(state) % (data.size() + 1)), static_cast<char>(xorshift(state)));
+				}
+				break;
+			case 3:
+				if(!data.empty()) {
+					data.erase(position, 1 + xorshift(state) % std::min<size_t>(data.size() - position, 16));
+				}
+				break;
+			case 4:
+				if(data.size() > 1) {
+					size_t from = xorshift(state) % data.size();
+					size_t length = 1 + xorshift(state) % std::min(data.size() - from, data.size() - position);
+					std::string chunk = data.substr(from, length);
+					data.replace(position, length, chunk);
+				}
+				break;
+			case 5:
+				if(!data.empty()) {
+					data[position] = static_cast<char>(interesting[xorshift(state) % sizeof(interesting)]);
+				}
+				break;
+			default:
+				if(!partner.empty()) {
+					size_t cut = xorshift(state) % partner.size();
+					data = data.substr(0, position) + partner.substr(cut);
+					data.resize(std::min<size_t>(data.size(), FUZZ_MAX_LENGTH));
+				}
+				break;
+			}
+		}
+	}
+
+	/**
+	 * hexName
+	 * -------------------
+	 * Returns the name a corpus input is saved under.
+	 */
+	static std::string hexName(const std::string& prefix, const std::string& input) {
+		std::ostringstream name;
+		name << prefix << std::hex << std::setfill('0') << std::setw(16) << File::hash(input.data(), input.size());
+		return name.str();
+	}
+
+	/**
+	 * readFile
+	 * -------------------
+	 * Returns the contents of the file at path.
+	 */
+	static std::string readFile(const std::string& path) {
+		std::ifstream file(path, std::ios::binary);
+		std::ostringstream contents;
+		contents << file.rdbuf();
+		return contents.str();
+	}
+
+	/**
+	 * listDirectory
+	 * -------------------
+	 * Returns the names of the files in directory.
+	 */
+	static std::vector<std::string> listDirectory(const std::string& directory) {
+		std::vector<std::string> names;
+#ifdef _WIN32
+		WIN32_FIND_DATAA entry;
+		HANDLE search = FindFirstFileA((directory + "\\*").c_str(), &entry);
+
+		if(search == INVALID_HANDLE_VALUE) {
+			return names;
+		}
+
+		do {
+			if(!(entry.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)) {
+				names.push_back(entry.cFileName);
+			}
+		} while(FindNextFileA(search, &entry));
+
+		FindClose(search);
+#else
+		DIR* listing = opendir(directory.c_str());
+
+		if(listing == nullptr) {
+			return names;
+		}
+
+		for(dirent* entry = readdir(listing); entry != nullptr; entry = readdir(listing)) {
+			if(entry->d_name[0] != '.') {
+				names.push_back(entry->d_name);
+			}
+		}
+
+		closedir(listing);
+#endif
+		std::sort(names.begin(), names.end());
+		return names;
+	}
+
+#ifndef _WIN32
+	// Gives the calling thread a stack of its own to handle signals on
+	// while in scope, so that the crash handler can still save the input
+	// when the target overflows the thread's stack.
+	struct AlternateStack {
+		std::unique_ptr<char[]> memory;
+		stack_t previous;
+
+		AlternateStack() : memory(new char[FUZZ_SIGNAL_STACK]) {
+			stack_t stack;
+			stack.ss_sp = memory.get();
+			stack.ss_size = FUZZ_SIGNAL_STACK;
+			stack.ss_flags = 0;
+			sigaltstack(&stack, &previous);
+		}
+
+		~AlternateStack() {
+			sigaltstack(&previous, nullptr);
+		}
+	};
+#endif
+
+	// The counters of a fuzzing campaign. Kept in memory shared with
+	// the child process the campaign runs in, so that they survive
+	// the child crashing.
+	struct FuzzProgress {
+		std::atomic<size_t> executed, features, corpus;
+		std::atomic<bool> instrumented;
+
+		FuzzProgress() : executed(0), features(0), corpus(0), instrumented(false) { };
+	};
+
+	/**
+	 * campaign
+	 * -------------------
+	 * Run the seed inputs, then mutate the corpus on worker threads
+	 * until runs inputs have been tried or one fails. Crashes save the
+	 * crashing input to crashFile, unless it is empty.
+	 * @return Whether an input failed; failing receives it.
+	 */
+	static bool campaign(const FuzzTarget& target, int workers, size_t runs, const std::vector<std::string>& inputs,
+						 const std::string& corpus, uint64_t seed, const std::string& crashFile,
+						 FuzzProgress& progress, std::string& failing) {
+		// Every input reaching a new (edge, hit count range) pair is kept.
+		std::unique_ptr<std::atomic<uint8_t>[]> seen(new std::atomic<uint8_t>[FUZZ_MAP_SIZE]());
+		std::atomic<bool> stop(false);
+		std::mutex corpusMutex;
+		std::vector<std::string> shared;
+
+		std::strncpy(crashPath, crashFile.c_str(), sizeof(crashPath) - 1);
+		crashPath[sizeof(crashPath) - 1] = '\0';
+		crashSaved.clear();
+#ifdef _WIN32
+		std::vector<void (*)(int)> previousHandlers;
+
+		for(int signal : crashSignals) {
+			previousHandlers.push_back(std::signal(signal, onCrash));
+		}
+#else
+		std::vector<struct sigaction> previousHandlers(sizeof(crashSignals) / sizeof(crashSignals[0]));
+		struct sigaction handler;
+		std::memset(&handler, 0, sizeof(handler));
+		handler.sa_handler = onCrash;
+		handler.sa_flags = SA_ONSTACK;
+		sigemptyset(&handler.sa_mask);
+
+		for(size_t i = 0; i < previousHandlers.size(); i++) {
+			sigaction(crashSignals[i], &handler, &previousHandlers[i]);
+		}
+
+		AlternateStack signalStack;
+#endif
+
+		// Run an input, returning whether it passed and counting its new
+		// coverage. Maps are held as words, so that untouched stretches
+		// can be skipped eight counters at a time.
+		auto attempt = [&](const std::string& input, std::vector<uint64_t>& map, size_t& found) -> bool {
+			uint8_t* counters = reinterpret_cast<uint8_t*>(map.data());
+
+			std::fill(map.begin(), map.end(), 0);
+			coverageMap = counters;
+			crashInput = input.data();
+			crashLength = input.size();
+
+			bool passed = execute(target, input);
+
+			coverageMap = nullptr;
+			crashInput = nullptr;
+			found = 0;
+
+			for(size_t word = 0; word < map.size(); word++) {
+				if(map[word] == 0) {
+					continue;
+				}
+
+				for(size_t edge = word * sizeof(uint64_t); edge < (word + 1) * sizeof(uint64_t); edge++) {
+					if(counters[edge] != 0) {
+						uint8_t bit = bucket(counters[edge]);
+
+						if((seen[edge].load(std::memory_order_relaxed) & bit) == 0 && (seen[edge].fetch_or(bit) & bit) == 0) {
+							found++;
+						}
+					}
+				}
+			}
+
+			if(found > 0) {
+				progress.instrumented = true;
+				progress.features += found;
+			}
+
+			return passed;
+		};
+
+		// Seeds form the starting corpus whether or not they add coverage.
+		std::vector<uint64_t> seedMap(FUZZ_MAP_SIZE / sizeof(uint64_t));
+
+		for(size_t i = 0; i < inputs.size() && !stop; i++) {
+			size_t found;
+			progress.executed++;
+
+			if(!attempt(inputs[i], seedMap, found)) {
+				failing = inputs[i];
+				stop = true;
+			}
+
+			shared.push_back(inputs[i]);
+		}
+
+		progress.corpus = shared.size();
+		std::vector<std::thread> pool;
+		std::mutex failureMutex;
+
+		for(int worker = 0; worker < std::max(workers, 1); worker++) {
+			pool.push_back(std::thread([&, worker]() {
+#ifndef _WIN32
+				AlternateStack signalStack;
+#endif
+				std::vector<uint64_t> map(FUZZ_MAP_SIZE / sizeof(uint64_t));
+				uint64_t state = seed ^ (0x9E3779B97F4A7C15ULL * (worker + 1));
+
+				while(!stop && progress.executed++ < runs) {
+					std::string input, partner;
+
+					{
+						std::lock_guard<std::mutex> lock(corpusMutex);
+						input = shared[xorshift(state) % shared.size()];
+						partner = shared[xorshift(state) % shared.size()];
+					}
+
+					mutate(input, state, partner);
+
+					size_t found;
+
+					if(!attempt(input, map, found)) {
+						std::lock_guard<std::mutex> lock(failureMutex);
+
+						if(!stop) {
+							failing = input;
+							stop = true;
+						}
+
+						break;
+					}
+
+					if(found > 0) {
+						std::lock_guard<std::mutex> lock(corpusMutex);
+						shared.push_back(input);
+						progress.corpus = shared.size();
+
+						if(!corpus.empty()) {
+							File::writeAtomically(corpus + "/" + hexName("", input), input.data(), input.size());
+						}
+					}
+				}
+			}));
+		}
+
+		for(auto& thread : pool) {
+			thread.join();
+		}
+
+		for(size_t i = 0; i < previousHandlers.size(); i++) {
+#ifdef _WIN32
+			std::signal(crashSignals[i], previousHandlers[i]);
+#else
+			sigaction(crashSignals[i], &previousHandlers[i], nullptr);
+#endif
+		}
+
+		crashPath[0] = '\0';
+		progress.corpus = shared.size();
+		// Workers only stop early when an input fails.
+		return stop;
+	}
+
+	/**
+	 * Fuzz::run
+	 * -------------------
+	 * Mutate inputs and run target on them until runs inputs have been
+	 * tried or one fails. Files in corpus seed the run, and new inputs
+	 * are saved there. Crashes left in corpus by an earlier run, as
+	 * crash-* files, are replayed first. Where fork is available the
+	 * inputs run in a child process, so that a crash fails the run
+	 * rather than ending the program. If the child dies without
+	 * handing back its input, e.g. when killed, the run fails with
+	 * inputLost set and nothing is minimised or saved.
+	 * @param target - The function to fuzz
+	 * @param workers - The number of worker threads
+	 * @param runs - The number of inputs to try, over all workers
+	 * @param corpus - The corpus directory, or an empty string to keep
+	 *				the corpus in memory.
+	 */
+	FuzzReport Fuzz::run(const FuzzTarget& target, int workers, size_t runs, const std::string& corpus) {
+		FuzzReport report = { 0, 0, 0, false, false, "", "", 0, 0, 0, false };
+		std::vector<std::string> inputs;
+		std::string failing;
+		std::string replayedPath;
+
+		if(!corpus.empty()) {
+			File::makeDirectory(corpus);
+
+			for(auto& name : listDirectory(corpus)) {
+				std::string input = readFile(corpus + "/" + name);
+
+				// Crashes from an earlier run are checked before anything else.
+				if(name.compare(0, 6, "crash-") == 0) {
+					if(fails(target, input)) {
+						failing = input;
+						replayedPath = corpus + "/" + name;
+						break;
+					}
+
+					std::remove((corpus + "/" + name).c_str());
+				} else {
+					inputs.push_back(input);
+				}
+			}
+		}
+
+		if(inputs.empty()) {
+			inputs.push_back("");
+		}
+
+		uint64_t seed = static_cast<uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count()) | 1;
+		// Where a failing input is handed back from the child process,
+		// and where a crash is saved if the whole process goes down.
+		std::string failurePath = corpus + "/crash-" + std::to_string(seed);
+		bool failed = !replayedPath.empty();
+		FuzzProgress local;
+		FuzzProgress* progress = &local;
+		bool contained = false;
+
+#ifndef _WIN32
+		if(corpus.empty()) {
+			const char* temporary = std::getenv("TMPDIR");
+			failurePath = std::string(temporary != nullptr && *temporary ? temporary : "/tmp") +
+						  "/earl-fuzz-" + std::to_string(getpid()) + "-" + std::to_string(seed);
+		}
+
+		void* memory = failed ? MAP_FAILED : mmap(nullptr, sizeof(FuzzProgress), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+
+		if(memory != MAP_FAILED) {
+			pid_t child;
+			progress = new(memory) FuzzProgress();
+
+			// Only the forking thread survives in the child, so fork while
+			// holding stdout to be sure no other thread is left owning it.
+			{
+				std::unique_lock<std::mutex> output = Print::hold();
+				child = fork();
+			}
+
+			if(child == 0) {
+				bool childFailed = campaign(target, workers, runs, inputs, corpus, seed, failurePath, *progress, failing);
+
+				if(childFailed) {
+					File::writeAtomically(failurePath, failing.data(), failing.size());
+				}
+
+				std::cout.flush();
+				_exit(childFailed ? 1 : 0);
+			}
+
+			if(child > 0) {
+				int status = 0;
+				contained = true;
+
+				while(waitpid(child, &status, 0) < 0 && errno == EINTR) {
+				}
+
+				if(!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+					failed = true;
+					report.crashSignal = WIFSIGNALED(status) ? WTERMSIG(status) : 0;
+
+					// The child can die without saving its input, e.g. when
+					// it is killed or the target calls exit itself.
+					if(File::exists(failurePath)) {
+						failing = readFile(failurePath);
+						replayedPath = failurePath;
+					} else {
+						report.exitCode = WIFEXITED(status) ? WEXITSTATUS(status) : 0;
+						report.inputLost = true;
+					}
+				}
+			}
+		}
+#endif
+		if(!failed && !contained) {
+			// Without a child process, a crash can only be saved to the corpus.
+			failed = campaign(target, workers, runs, inputs, corpus, seed, corpus.empty() ? "" : failurePath, *progress, failing);
+		}
+
+		report.runs = std::min(progress->executed.load(), std::max(runs, inputs.size()));
+		report.corpus = progress->corpus;
+		report.features = progress->features;
+		report.instrumented = progress->instrumented;
+		report.failed = failed;
+
+#ifndef _WIN32
+		if(progress != &local) {
+			progress->~FuzzProgress();
+			munmap(progress, sizeof(FuzzProgress));
+		}
+#endif
+
+		if(report.failed && !report.inputLost) {
+			report.originalLength = failing.size();
+			report.failure = minimize(target, failing);
+
+			if(!corpus.empty()) {
+				report.failurePath = corpus + "/" + hexName("crash-", report.failure);
+				File::writeAtomically(report.failurePath, report.failure.data(), report.failure.size());
+			}
+
+			// The minimised crash replaces the one it was found as.
+			if(!replayedPath.empty() && replayedPath != report.failurePath) {
+				std::remove(replayedPath.c_str());
+			}
+		}
+
+		return report;
+	}
+
+	/**
+	 * Fuzz::fails
+	 * -------------------
+	 * Returns whether target fails on input, by returning false,
+	 * throwing or crashing. Runs in a child process where fork is
+	 * available, so that crashes can be detected.
+	 * @param target - The function to run
+	 * @param input - The input to run it on
+	 */
+	bool Fuzz::fails(const FuzzTarget& target, const std::string& input) {
+#ifndef _WIN32
+		pid_t child;
+		int status = 0;
+
+		// Only the forking thread survives in the child, so fork while
+		// holding stdout to be sure no other thread is left owning it.
+		{
+			std::unique_lock<std::mutex> output = Print::hold();
+			child = fork();
+		}
+
+		if(child == 0) {
+			bool passed = execute(target, input);
+			std::cout.flush();
+			_exit(passed ? 0 : 1);
+		}
+
+		if(child > 0) {
+			while(waitpid(child, &status, 0) < 0) {
+				if(errno != EINTR) {
+					return true;
+				}
+			}
+
+			return !WIFEXITED(status) || WEXITSTATUS(status) != 0;
+		}
+#endif
+		return !execute(target, input);
+	}
+
+	/**
+	 * Fuzz::minimize
+	 * -------------------
+	 * Shrink a failing input by removing chunks and simplifying bytes,
+	 * for as long as it keeps failing.
+	 * @param target - The function which fails
+	 * @param input - The failing input
+	 * @return The smallest failing input found.
+	 */
+	std::string Fuzz::minimize(const FuzzTarget& target, std::string input) {
+		// Remove ever smaller chunks, starting with the whole input.
+		for(size_t chunk = input.size(); chunk > 0; chunk /= 2) {
+			for(size_t offset = 0; offset + chunk <= input.size();) {
+				std::string candidate = input.substr(0, offset) + input.substr(offset + chunk);
+
+				if(fails(target, candidate)) {
+					input = candidate;
+				} else {
+					offset += chunk;
+				}
+			}
+		}
+
+		// Then replace what is left with zeros where possible.
+		for(size_t i = 0; i < input.size(); i++) {
+			if(input[i] != '\0') {
+				std::string candidate = input;
+				candidate[i] = '\0';
+
+				if(fails(target, candidate)) {
+					input = candidate;
+				}
+			}
+		}
+
+		return input;
+	}
+};
@@ -0,0 +1,120 @@
+/*******************************************************************************
+ * Copyright (c) 2014, Niall Frederick Weedon and other Contributors
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without modification, 
+ * are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, this 
+ * list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ * this list of conditions and the following disclaimer in the documentation and/or 
+ * other materials provided with the distribution.
+ * 
+ * 3. Neither the name of the copyright holder nor the names of its contributors may
+ * be used to endorse or promote products derived from this software without 
+ * specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE 
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE 
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL 
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR 
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, 
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE 
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *******************************************************************************/
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+
+// Size of the coverage map each fuzzing worker records into.
+#define FUZZ_MAP_SIZE 65536
+// The largest input the mutator produces.
+#define FUZZ_MAX_LENGTH 4096
+// Size of the stack each fuzzing thread handles crashes on.
+#define FUZZ_SIGNAL_STACK 65536
+
+namespace Earl {
+	// A function under fuzzing; returns false if the input exposed a bug.
+	typedef std::function<bool(const uint8_t*, size_t)> FuzzTarget;
+
+	// The outcome of Fuzz::run.
+	struct FuzzReport {
+		size_t runs, corpus, features;
+		// Whether any coverage instrumentation reported in.
+		bool instrumented;
+		bool failed;
+		// The failing input, minimised, and the file it was saved to.
+		std::string failure, failurePath;
+		size_t originalLength;
+		// The signal the target crashed with, or 0.
+		int crashSignal;
+		// The code the campaign's process exited with when it failed
+		// without a failing input, or 0.
+		int exitCode;
+		// Whether the campaign failed without handing back a failing
+		// input, e.g. when it was killed or the target exited.
+		bool inputLost;
+	};
+
+	/**
+	 * Fuzz
+	 * -------------------
+	 * An in-process, coverage-guided mutation fuzzer. Coverage comes from
+	 * code built with -fsanitize-coverage=trace-pc-guard (Clang) or
+	 * -fsanitize-coverage=trace-pc (GCC), whose hooks Earl provides;
+	 * without instrumentation inputs are mutated blindly. Each worker
+	 * thread records coverage into its own map, and inputs which reach
+	 * new coverage are shared through one corpus.
+	 */
+	class Fuzz {
+	public:
+		/**
+		 * Fuzz::run
+		 * -------------------
+		 * Mutate inputs and run target on them until runs inputs have been
+		 * tried or one fails. Files in corpus seed the run, and new inputs
+		 * are saved there. Crashes left in corpus by an earlier run, as
+		 * crash-* files, are replayed first. Where fork is available the
+		 * inputs run in a child process, so that a crash fails the run
+		 * rather than ending the program. If the child dies without
+		 * handing back its input, e.g. when killed, the run fails with
+		 * inputLost set and nothing is minimised or saved.
+		 * @param target - The function to fuzz
+		 * @param workers - The number of worker threads
+		 * @param runs - The number of inputs to try, over all workers
+		 * @param corpus - The corpus directory, or an empty string to keep
+		 *				the corpus in memory.
+		 */
+		static FuzzReport run(const FuzzTarget&, int, size_t, const std::string&);
+
+		/**
+		 * Fuzz::fails
+		 * -------------------
+		 * Returns whether target fails on input, by returning false,
+		 * throwing or crashing. Runs in a child process where fork is
+		 * available, so that crashes can be detected.
+		 * @param target - The function to run
+		 * @param input - The input to run it on
+		 */
+		static bool fails(const FuzzTarget&, const std::string&);
+
+		/**
+		 * Fuzz::minimize
+		 * -------------------
+		 * Shrink a failing input by removing chunks and simplifying bytes,
+		 * for as long as it keeps failing.
+		 * @param target - The function which fails
+		 * @param input - The failing input
+		 * @return The smallest failing input found.
+		 */
+		static std::string minimize(const FuzzTarget&, std::string);
+	};
+};
@@ -0,0 +1,364 @@
+/*******************************************************************************
+ * Copyright (c) 2014, Niall Frederick Weedon and other Contributors
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without modification, 
+ * are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, this 
+ * list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ * this list of conditions and the following disclaimer in the documentation and/or 
+ * other materials provided with the distribution.
+ * 
+ * 3. Neither the name of the copyright holder nor the names of its contributors may
+ * be used to endorse or promote products derived from this software without 
+ * specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE 
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE 
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL 
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR 
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, 
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE 
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *******************************************************************************/
+#include "EarlMetrics.h"
+#include "EarlFile.h"
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <sstream>
+
+namespace Earl {
+	std::atomic<bool> Metrics::running(false);
+	std::string Metrics::path = "";
+	int Metrics::interval = DEFAULT_METRICS_INTERVAL_MS;
+	uint64_t Metrics::origin = 0;
+	std::atomic<long> Metrics::queued(0);
+	std::atomic<long> Metrics::pending(0);
+	std::atomic<long> Metrics::completed(0);
+	std::atomic<long> Metrics::failed(0);
+	std::atomic<long> Metrics::flaky(0);
+	std::atomic<long> Metrics::cached(0);
+	std::mutex Metrics::writeMutex;
+	std::mutex Metrics::workersMutex;
+	std::vector<std::unique_ptr<WorkerMetrics>> Metrics::workers;
+	std::mutex Metrics::wakeMutex;
+	std::condition_variable Metrics::wake;
+	std::thread Metrics::writer;
+
+	// Stops the writer before the statics above are destroyed.
+	static struct MetricsShutdown {
+		~MetricsShutdown() { Metrics::stop(); }
+	} metricsShutdown;
+
+	static uint64_t nanoseconds() {
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	/**
+	 * label
+	 * -------------------
+	 * Escape s for use as a Prometheus label value.
+	 */
+	static std::string label(const std::string& s) {
+		std::string escaped;
+
+		for(char c : s) {
+			if(c == '\\' || c == '"') {
+				escaped += '\\';
+				escaped += c;
+			} else if(c == '\n') {
+				escaped += "\\n";
+			} else {
+				escaped += c;
+			}
+		}
+
+		return escaped;
+	}
+
+	/**
+	 * publish
+	 * -------------------
+	 * Copy value into a worker's name, truncating it on a
+	 * UTF-8 character boundary.
+	 */
+	static void publish(std::atomic<char>* name, const std::string& value) {
+		size_t length = std::min(value.size(), static_cast<size_t>(METRICS_NAME_LENGTH - 1));
+
+		while(length < value.size() && length > 0 && (static_cast<unsigned char>(value[length]) & 0xC0) == 0x80) {
+			length--;
+		}
+
+		for(size_t i = 0; i < length; i++) {
+			name[i].store(value[i], std::memory_order_relaxed);
+		}
+
+		name[length].store('\0', std::memory_order_relaxed);
+	}
+
+	/**
+	 * sample
+	 * -------------------
+	 * Read a worker's name, which may be changing underneath.
+	 */
+	static std::string sample(const std::atomic<char>* name) {
+		std::string value;
+
+		for(size_t i = 0; i < METRICS_NAME_LENGTH; i++) {
+			char c = name[i].load(std::memory_order_relaxed);
+
+			if(c == '\0') {
+				break;
+			}
+
+			value += c;
+		}
+
+		return value;
+	}
+
+	static void metric(std::ostringstream& out, const char* name, const char* type, const char* help, double value) {
+		out << "# HELP " << name << " " << help << "\n"
+			<< "# TYPE " << name << " " << type << "\n"
+			<< name << " " << value << "\n";
+	}
+
+	/**
+	 * Metrics::start
+	 * -------------------
+	 * Start writing metrics to path every interval milliseconds,
+	 * stopping any previous writer.
+	 * @param path - The metrics file
+	 * @param interval - Milliseconds between writes
+	 */
+	void Metrics::start(std::string metricsPath, int intervalMs) {
+		stop();
+
+		path = metricsPath;
+		interval = intervalMs > 0 ? intervalMs : DEFAULT_METRICS_INTERVAL_MS;
+		origin = nanoseconds();
+		completed = failed = flaky = cached = 0;
+		// Synchronous tests run on the calling thread, as worker zero.
+		prepare(1);
+		running = true;
+
+		writer = std::thread([]() {
+			std::unique_lock<std::mutex> lock(wakeMutex);
+
+			while(running) {
+				lock.unlock();
+				write();
+				lock.lock();
+				wake.wait_for(lock, std::chrono::milliseconds(interval));
+			}
+		});
+	}
+
+	/**
+	 * Metrics::stop
+	 * -------------------
+	 * Stop the writer. Call Metrics::flush first to write
+	 * the final figures.
+	 */
+	void Metrics::stop() {
+		if(!writer.joinable()) {
+			return;
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(wakeMutex);
+			running = false;
+		}
+
+		wake.notify_all();
+		writer.join();
+	}
+
+	/**
+	 * Metrics::flush
+	 * -------------------
+	 * Write the metrics now, rather than at the next interval.
+	 */
+	void Metrics::flush() {
+		if(running) {
+			write();
+		}
+	}
+
+	/**
+	 * Metrics::prepare
+	 * -------------------
+	 * Make sure the counters of workers [0, workers) exist. Must be
+	 * called before the workers start.
+	 * @param workers - The number of workers about to start
+	 */
+	void Metrics::prepare(size_t count) {
+		std::lock_guard<std::mutex> lock(workersMutex);
+
+		while(workers.size() < count) {
+			workers.push_back(std::unique_ptr<WorkerMetrics>(new WorkerMetrics()));
+		}
+	}
+
+	/**
+	 * Metrics::enqueue
+	 * -------------------
+	 * Count tests waiting for a worker.
+	 * @param count - The number of tests added to the queue
+	 */
+	void Metrics::enqueue(long count) {
+		queued += count;
+	}
+
+	/**
+	 * Metrics::dequeue
+	 * -------------------
+	 * Record that a worker took a test from the queue.
+	 */
+	void Metrics::dequeue() {
+		queued--;
+	}
+
+	/**
+	 * Metrics::setPending
+	 * -------------------
+	 * Publish the number of pending tests, so the writer need
+	 * not read the pending list while tests are registered.
+	 * @param count - The number of pending tests
+	 */
+	void Metrics::setPending(long count) {
+		pending = count;
+	}
+
+	/**
+	 * Metrics::begin
+	 * -------------------
+	 * Record that a worker started a test.
+	 * @param worker - The worker's index
+	 * @param suite - The test's suite
+	 * @param test - The test's description
+	 */
+	void Metrics::begin(size_t worker, const std::string& suite, const std::string& test) {
+		WorkerMetrics& metrics = *workers[worker];
+
+		// started is 0 here; the fence keeps the writer from seeing the
+		// new names without also seeing that it changed.
+		std::atomic_thread_fence(std::memory_order_release);
+		publish(metrics.suite, suite);
+		publish(metrics.test, test);
+		metrics.started.store(nanoseconds() - origin + 1, std::memory_order_release);
+	}
+
+	/**
+	 * Metrics::end
+	 * -------------------
+	 * Record that a worker finished its current test.
+	 * @param worker - The worker's index
+	 * @param passed - Whether the test passed
+	 * @param flaky - Whether it only passed on a retry
+	 */
+	void Metrics::end(size_t worker, bool passed, bool flakyTest) {
+		WorkerMetrics& metrics = *workers[worker];
+		uint64_t started = metrics.started.exchange(0);
+
+		if(started != 0) {
+			metrics.busy += nanoseconds() - origin + 1 - started;
+		}
+
+		if(flakyTest) {
+			flaky++;
+		} else if(!passed) {
+			failed++;
+		}
+
+		completed++;
+	}
+
+	/**
+	 * Metrics::skip
+	 * -------------------
+	 * Record that a test was skipped because its result was cached.
+	 */
+	void Metrics::skip() {
+		cached++;
+		completed++;
+	}
+
+	/**
+	 * Metrics::write
+	 * -------------------
+	 * Sample the counters and replace the metrics file.
+	 */
+	void Metrics::write() {
+		std::lock_guard<std::mutex> writeLock(writeMutex);
+		std::ostringstream out, elapsedTests, utilization;
+		double elapsed = (nanoseconds() - origin) / 1e9;
+		uint64_t now = nanoseconds() - origin + 1;
+		long finished = completed;
+		int inFlight = 0;
+		size_t workerCount;
+		double busy = 0;
+
+		{
+			std::lock_guard<std::mutex> lock(workersMutex);
+
+			for(size_t worker = 0; worker < workers.size(); worker++) {
+				WorkerMetrics& metrics = *workers[worker];
+				uint64_t started = metrics.started.load(std::memory_order_acquire);
+				double workerBusy = metrics.busy / 1e9;
+
+				if(started != 0 && now > started) {
+					double seconds = (now - started) / 1e9;
+					std::string suite = sample(metrics.suite), test = sample(metrics.test);
+
+					// The names are only whole if the test did not change
+					// while they were read.
+					std::atomic_thread_fence(std::memory_order_acquire);
+
+					if(metrics.started.load(std::memory_order_relaxed) == started) {
+						elapsedTests << "earl_test_elapsed_seconds{worker=\"" << worker << "\",suite=\"" << label(suite)
+									 << "\",test=\"" << label(test) << "\"} " << seconds << "\n";
+					}
+
+					workerBusy += seconds;
+					inFlight++;
+				}
+
+				utilization << "earl_worker_utilization{worker=\"" << worker << "\"} "
+							<< (elapsed > 0 ? workerBusy / elapsed : 0) << "\n";
+				busy += workerBusy;
+			}
+
+			workerCount = workers.size();
+		}
+
+		metric(out, "earl_tests_completed", "counter", "Tests which have finished, including cached tests.", finished);
+		metric(out, "earl_tests_failed", "counter", "Tests which have failed.", failed.load());
+		metric(out, "earl_tests_flaky", "counter", "Tests which passed on a retry.", flaky.load());
+		metric(out, "earl_tests_cached", "counter", "Tests skipped because their result was cached.", cached.load());
+		metric(out, "earl_tests_pending", "gauge", "Tests declared without an implementation.", pending.load());
+		metric(out, "earl_queue_depth", "gauge", "Tests waiting for a worker.", queued > 0 ? queued.load() : 0L);
+		metric(out, "earl_tests_in_flight", "gauge", "Tests being run.", inFlight);
+		metric(out, "earl_tests_per_second", "gauge", "Tests completed per second since metrics started.", elapsed > 0 ? finished / elapsed : 0);
+		metric(out, "earl_elapsed_seconds", "gauge", "Seconds since metrics started.", elapsed);
+
+		out << "# HELP earl_test_elapsed_seconds Seconds each in-flight test has been running.\n"
+			<< "# TYPE earl_test_elapsed_seconds gauge\n" << elapsedTests.str()
+			<< "# HELP earl_worker_utilization Fraction of the time each worker has spent running tests.\n"
+			<< "# TYPE earl_worker_utilization gauge\n" << utilization.str();
+
+		metric(out, "earl_workers_utilization", "gauge", "Fraction of the time all workers have spent running tests.",
+			elapsed > 0 && workerCount > 0 ? busy / (elapsed * workerCount) : 0);
+
+		std::string contents = out.str();
+		File::writeAtomically(path, contents.data(), contents.size());
+	}
+};
@@ -0,0 +1,180 @@
+/*******************************************************************************
+ * Copyright (c) 2014, Niall Frederick Weedon and other Contributors
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without modification, 
+ * are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, this 
+ * list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ * this list of conditions and the following disclaimer in the documentation and/or 
+ * other materials provided with the distribution.
+ * 
+ * 3. Neither the name of the copyright holder nor the names of its contributors may
+ * be used to endorse or promote products derived from this software without 
+ * specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE 
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE 
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL 
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR 
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, 
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE 
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *******************************************************************************/
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define DEFAULT_METRICS_INTERVAL_MS 1000
+// The longest suite or test name published for a worker, in bytes.
+#define METRICS_NAME_LENGTH 128
+
+namespace Earl {
+	// What one worker is doing, as seen by the metrics writer.
+	struct WorkerMetrics {
+		// When the current test started, or 0 when idle. The names below
+		// are only changed while it is 0, so the writer discards names it
+		// read while started changed.
+		std::atomic<uint64_t> started;
+		// Time spent running tests, in nanoseconds.
+		std::atomic<uint64_t> busy;
+		// The current test's suite and description, nul-terminated.
+		std::atomic<char> suite[METRICS_NAME_LENGTH], test[METRICS_NAME_LENGTH];
+
+		WorkerMetrics() : started(0), busy(0) { };
+	};
+
+	/**
+	 * Metrics
+	 * -------------------
+	 * Periodically writes the progress of a run to a file in the
+	 * Prometheus text format, so long runs can be watched (or scraped
+	 * by a node exporter's textfile collector) while they are going.
+	 * Workers publish their current test in their own slot and count
+	 * results in atomics, without taking a lock; a background thread
+	 * samples them and writes the file.
+	 */
+	class Metrics {
+	private:
+		static std::atomic<bool> running;
+		static std::string path;
+		static int interval;
+		static uint64_t origin;
+		static std::atomic<long> queued;
+		static std::atomic<long> pending;
+		// Tests finished since metrics started, and how they ended.
+		static std::atomic<long> completed, failed, flaky, cached;
+		// Serialises write(), which Metrics::flush calls from
+		// outside the writer thread.
+		static std::mutex writeMutex;
+		// Guards the size of workers; the writer holds it while sampling.
+		static std::mutex workersMutex;
+		static std::vector<std::unique_ptr<WorkerMetrics>> workers;
+		static std::mutex wakeMutex;
+		static std::condition_variable wake;
+		static std::thread writer;
+
+		static void write();
+	public:
+		/**
+		 * Metrics::start
+		 * -------------------
+		 * Start writing metrics to path every interval milliseconds,
+		 * stopping any previous writer.
+		 * @param path - The metrics file
+		 * @param interval - Milliseconds between writes
+		 */
+		static void start(std::string, int);
+
+		/**
+		 * Metrics::stop
+		 * -------------------
+		 * Stop the writer. Call Metrics::flush first to write
+		 * the final figures.
+		 */
+		static void stop();
+
+		static bool enabled() { return running.load(std::memory_order_relaxed); };
+
+		/**
+		 * Metrics::flush
+		 * -------------------
+		 * Write the metrics now, rather than at the next interval.
+		 */
+		static void flush();
+
+		/**
+		 * Metrics::prepare
+		 * -------------------
+		 * Make sure the counters of workers [0, workers) exist. Must be
+		 * called before the workers start.
+		 * @param workers - The number of workers about to start
+		 */
+		static void prepare(size_t);
+
+		/**
+		 * Metrics::enqueue
+		 * -------------------
+		 * Count tests waiting for a worker.
+		 * @param count - The number of tests added to the queue
+		 */
+		static void enqueue(long);
+
+		/**
+		 * Metrics::dequeue
+		 * -------------------
+		 * Record that a worker took a test from the queue.
+		 */
+		static void dequeue();
+
+		/**
+		 * Metrics::setPending
+		 * -------------------
+		 * Publish the number of pending tests, so the writer need
+		 * not read the pending list while tests are registered.
+		 * @param count - The number of pending tests
+		 */
+		static void setPending(long);
+
+		/**
+		 * Metrics::begin
+		 * -------------------
+		 * Record that a worker started a test.
+		 * @param worker - The worker's index
+		 * @param suite - The test's suite
+		 * @param test - The test's description
+		 */
+		static void begin(size_t, const std::string&, const std::string&);
+
+		/**
+		 * Metrics::end
+		 * -------------------
+		 * Record that a worker finished its current test.
+		 * @param worker - The worker's index
+		 * @param passed - Whether the test passed
+		 * @param flaky - Whether it only passed on a retry
+		 */
+		static void end(size_t, bool, bool);
+
+		/**
+		 * Metrics::skip
+		 * -------------------
+		 * Record that a test was skipped because its result was cached.
+		 */
+		static void skip();
+	};
+};
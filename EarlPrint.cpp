@@ -50,4 +50,20 @@ namespace Earl {
 	void Print::fragment(std::string s, std::string colour) {
 		base(s, colour, true);
 	}
+
+	// Print a coloured label followed by a line of text, without
+	// output from other threads appearing between the two.
+	void Print::status(std::string label, std::string colour, std::string s) {
+		std::lock_guard<std::mutex> g_stdout(stdoutMutex);
+		std::cout << colour << label << WHITE << s << std::endl;
+	}
+
+	// Keep other threads from printing until the lock is released,
+	// e.g. so that a child process is never forked while one of
+	// them is part way through a line.
+	std::unique_lock<std::mutex> Print::hold() {
+		std::unique_lock<std::mutex> lock(stdoutMutex);
+		std::cout.flush();
+		return lock;
+	}
 };
\ No newline at end of file
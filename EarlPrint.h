@@ -49,5 +49,7 @@ namespace Earl {
 		~Print() { };
 		static void line(std::string s, std::string colour = WHITE);
 		static void fragment(std::string s, std::string colour = WHITE);
+		static void status(std::string label, std::string colour, std::string s);
+		static std::unique_lock<std::mutex> hold();
 	};
 };
\ No newline at end of file
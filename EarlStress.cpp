@@ -0,0 +1,263 @@
+/*******************************************************************************
+ * Copyright (c) 2014, Niall Frederick Weedon and other Contributors
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without modification, 
+ * are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, this 
+ * list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ * this list of conditions and the following disclaimer in the documentation and/or 
+ * other materials provided with the distribution.
+ * 
+ * 3. Neither the name of the copyright holder nor the names of its contributors may
+ * be used to endorse or promote products derived from this software without 
+ * specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE 
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE 
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL 
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR 
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, 
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE 
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *******************************************************************************/
+#include "EarlStress.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <thread>
+
+// Spins before a waiting thread yields, so that threads
+// outnumbering the cores still reach the barrier.
+#define SPINS_BEFORE_YIELD 128
+
+namespace Earl {
+	SpinBarrier::SpinBarrier(int count) : count(count), waiting(0), sense(false) {}
+
+	/**
+	 * SpinBarrier::wait
+	 * -------------------
+	 * Spin until every thread has arrived.
+	 * @param localSense - The calling thread's sense, initially false
+	 *				and only ever passed to this barrier.
+	 */
+	void SpinBarrier::wait(bool& localSense) {
+		localSense = !localSense;
+
+		// The last thread to arrive flips the shared sense,
+		// releasing the rest.
+		if(waiting.fetch_add(1, std::memory_order_acq_rel) == count - 1) {
+			waiting.store(0, std::memory_order_relaxed);
+			sense.store(localSense, std::memory_order_release);
+			return;
+		}
+
+		for(int spins = 0; sense.load(std::memory_order_acquire) != localSense; spins++) {
+			if(spins >= SPINS_BEFORE_YIELD) {
+				std::this_thread::yield();
+			}
+		}
+	}
+
+	int StressReport::failed() const {
+		int total = 0;
+
+		for(int count : failures) {
+			total += count;
+		}
+
+		return total;
+	}
+
+	double StressReport::operationsPerSecond() const {
+		return seconds > 0 ? static_cast<double>(threads) * iterations / seconds : 0;
+	}
+
+	/**
+	 * xorshift
+	 * -------------------
+	 * Advance a xorshift64 generator and return its next value.
+	 */
+	static uint64_t xorshift(uint64_t& state) {
+		state ^= state << 13;
+		state ^= state >> 7;
+		state ^= state << 17;
+		return state;
+	}
+
+	/**
+	 * Stress::run
+	 * -------------------
+	 * Run operation on threads threads for iterations iterations,
+	 * releasing every thread from a barrier at the start of each
+	 * iteration.
+	 * @param threads - The number of threads
+	 * @param iterations - The number of iterations on each thread
+	 * @param operation - Called with the thread's index and the iteration;
+	 *				returns false if the iteration failed.
+	 * @param randomize - Whether to randomly yield or spin after each
+	 *				release, to vary the interleaving.
+	 * @param seed - Seeds the randomisation
+	 */
+	StressReport Stress::run(int threads, int iterations, const std::function<bool(int, int)>& operation, bool randomize, uint64_t seed) {
+		return execute(threads, iterations, operation, randomize, seed, true);
+	}
+
+	/**
+	 * Stress::measure
+	 * -------------------
+	 * Run operation on threads threads for iterations iterations,
+	 * starting every thread together but letting them run freely
+	 * after that, to measure throughput.
+	 * @param threads - The number of threads
+	 * @param iterations - The number of iterations on each thread
+	 * @param operation - Called with the thread's index and the iteration;
+	 *				returns false if the iteration failed.
+	 */
+	StressReport Stress::measure(int threads, int iterations, const std::function<bool(int, int)>& operation) {
+		return execute(threads, iterations, operation, false, 0, false);
+	}
+
+	/**
+	 * Stress::threadCounts
+	 * -------------------
+	 * Returns 1, 2, 4... up to and including maxThreads.
+	 * @param maxThreads - The largest thread count
+	 */
+	std::vector<int> Stress::threadCounts(int maxThreads) {
+		std::vector<int> counts;
+
+		for(int threads = 1; threads < maxThreads; threads *= 2) {
+			counts.push_back(threads);
+		}
+
+		counts.push_back(maxThreads > 1 ? maxThreads : 1);
+		return counts;
+	}
+
+	/**
+	 * Stress::scale
+	 * -------------------
+	 * Measure the throughput of operation at each of Stress::threadCounts,
+	 * with every thread running iterations iterations.
+	 * @param iterations - The number of iterations on each thread
+	 * @param operation - Called with the thread's index and the iteration
+	 * @param maxThreads - The largest thread count, or zero for the
+	 *				hardware concurrency.
+	 * @param failures - Receives the number of failed iterations, if not null
+	 */
+	std::vector<ScalingStep> Stress::scale(int iterations, const std::function<bool(int, int)>& operation, int maxThreads, int* failures) {
+		std::vector<ScalingStep> steps;
+
+		if(maxThreads <= 0) {
+			maxThreads = static_cast<int>(std::thread::hardware_concurrency());
+		}
+
+		if(failures != nullptr) {
+			*failures = 0;
+		}
+
+		for(int threads : threadCounts(maxThreads)) {
+			StressReport report = measure(threads, iterations, operation);
+			ScalingStep step;
+
+			step.threads = threads;
+			step.throughput = report.operationsPerSecond();
+			step.speedup = steps.empty() || steps[0].throughput <= 0 ? 1 : step.throughput / steps[0].throughput;
+			step.efficiency = step.speedup / threads;
+			step.negative = !steps.empty() && step.throughput < steps.back().throughput;
+			steps.push_back(step);
+
+			if(failures != nullptr) {
+				*failures += report.failed();
+			}
+		}
+
+		return steps;
+	}
+
+	StressReport Stress::execute(int threads, int iterations, const std::function<bool(int, int)>& operation, bool randomize, uint64_t seed, bool lockstep) {
+		StressReport report;
+		std::vector<std::thread> pool;
+
+		threads = threads > 0 ? threads : 1;
+		report.threads = threads;
+		report.iterations = iterations;
+		report.seed = seed;
+		report.failures.assign(threads, 0);
+		report.firstFailure.assign(threads, -1);
+
+		SpinBarrier barrier(threads);
+		// Each thread times itself, since the thread which starts
+		// them is not guaranteed to be running when they are released.
+		std::vector<std::chrono::steady_clock::time_point> started(threads), finished(threads);
+
+		for(int thread = 0; thread < threads; thread++) {
+			pool.push_back(std::thread([&, thread]() {
+				bool localSense = false;
+				uint64_t state = seed ^ (0x9E3779B97F4A7C15ULL * (thread + 1));
+				state = state == 0 ? 1 : state;
+
+				barrier.wait(localSense);
+				started[thread] = std::chrono::steady_clock::now();
+
+				for(int iteration = 0; iteration < iterations; iteration++) {
+					// The first iteration was released by the barrier above.
+					if(lockstep && iteration > 0) {
+						barrier.wait(localSense);
+					}
+
+					if(randomize) {
+						uint64_t roll = xorshift(state);
+
+						if((roll & 3) == 0) {
+							std::this_thread::yield();
+						} else {
+							for(volatile uint64_t spin = (roll >> 2) % 64; spin > 0; spin--) {}
+						}
+					}
+
+					// Failures are only counted on the thread's own slot.
+					if(!operation(thread, iteration)) {
+						if(report.failures[thread]++ == 0) {
+							report.firstFailure[thread] = iteration;
+						}
+					}
+				}
+
+				finished[thread] = std::chrono::steady_clock::now();
+			}));
+		}
+
+		for(auto& thread : pool) {
+			thread.join();
+		}
+
+		auto begin = *std::min_element(started.begin(), started.end());
+		auto end = *std::max_element(finished.begin(), finished.end());
+		report.seconds = std::chrono::duration<double>(end - begin).count();
+		return report;
+	}
+
+	/**
+	 * Stress::seed
+	 * -------------------
+	 * Returns the EARL_STRESS_SEED environment variable, so a failing
+	 * interleaving can be replayed, or a new seed if it is not set.
+	 */
+	uint64_t Stress::seed() {
+		const char* value = std::getenv("EARL_STRESS_SEED");
+
+		if(value != nullptr && *value != '\0') {
+			return std::strtoull(value, nullptr, 0);
+		}
+
+		return static_cast<uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count()) | 1;
+	}
+};
@@ -0,0 +1,150 @@
+/*******************************************************************************
+ * Copyright (c) 2014, Niall Frederick Weedon and other Contributors
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without modification, 
+ * are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, this 
+ * list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ * this list of conditions and the following disclaimer in the documentation and/or 
+ * other materials provided with the distribution.
+ * 
+ * 3. Neither the name of the copyright holder nor the names of its contributors may
+ * be used to endorse or promote products derived from this software without 
+ * specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE 
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE 
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL 
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR 
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, 
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE 
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *******************************************************************************/
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace Earl {
+	/**
+	 * SpinBarrier
+	 * -------------------
+	 * A sense-reversing barrier which releases its threads together,
+	 * without sleeping, so that they start each round as close to
+	 * simultaneously as possible.
+	 */
+	class SpinBarrier {
+	private:
+		const int count;
+		std::atomic<int> waiting;
+		std::atomic<bool> sense;
+	public:
+		SpinBarrier(int);
+
+		/**
+		 * SpinBarrier::wait
+		 * -------------------
+		 * Spin until every thread has arrived.
+		 * @param localSense - The calling thread's sense, initially false
+		 *				and only ever passed to this barrier.
+		 */
+		void wait(bool&);
+	};
+
+	// The outcome of Stress::run.
+	struct StressReport {
+		int threads, iterations;
+		// The seed the interleavings were randomised with.
+		uint64_t seed;
+		// Failed iterations on each thread, and the first of them (or -1).
+		std::vector<int> failures, firstFailure;
+		double seconds;
+
+		int failed() const;
+		double operationsPerSecond() const;
+	};
+
+	// One thread count of a scalability curve.
+	struct ScalingStep {
+		int threads;
+		// Operations per second, over all threads.
+		double throughput;
+		// Throughput relative to one thread, and that speedup per thread.
+		double speedup, efficiency;
+		// Whether throughput fell from the previous step.
+		bool negative;
+	};
+
+	class Stress {
+	private:
+		static StressReport execute(int, int, const std::function<bool(int, int)>&, bool, uint64_t, bool);
+	public:
+		/**
+		 * Stress::run
+		 * -------------------
+		 * Run operation on threads threads for iterations iterations,
+		 * releasing every thread from a barrier at the start of each
+		 * iteration.
+		 * @param threads - The number of threads
+		 * @param iterations - The number of iterations on each thread
+		 * @param operation - Called with the thread's index and the iteration;
+		 *				returns false if the iteration failed.
+		 * @param randomize - Whether to randomly yield or spin after each
+		 *				release, to vary the interleaving.
+		 * @param seed - Seeds the randomisation
+		 */
+		static StressReport run(int, int, const std::function<bool(int, int)>&, bool, uint64_t);
+
+		/**
+		 * Stress::measure
+		 * -------------------
+		 * Run operation on threads threads for iterations iterations,
+		 * starting every thread together but letting them run freely
+		 * after that, to measure throughput.
+		 * @param threads - The number of threads
+		 * @param iterations - The number of iterations on each thread
+		 * @param operation - Called with the thread's index and the iteration;
+		 *				returns false if the iteration failed.
+		 */
+		static StressReport measure(int, int, const std::function<bool(int, int)>&);
+
+		/**
+		 * Stress::threadCounts
+		 * -------------------
+		 * Returns 1, 2, 4... up to and including maxThreads.
+		 * @param maxThreads - The largest thread count
+		 */
+		static std::vector<int> threadCounts(int);
+
+		/**
+		 * Stress::scale
+		 * -------------------
+		 * Measure the throughput of operation at each of Stress::threadCounts,
+		 * with every thread running iterations iterations.
+		 * @param iterations - The number of iterations on each thread
+		 * @param operation - Called with the thread's index and the iteration
+		 * @param maxThreads - The largest thread count, or zero for the
+		 *				hardware concurrency.
+		 * @param failures - Receives the number of failed iterations, if not null
+		 */
+		static std::vector<ScalingStep> scale(int, const std::function<bool(int, int)>&, int = 0, int* = nullptr);
+
+		/**
+		 * Stress::seed
+		 * -------------------
+		 * Returns the EARL_STRESS_SEED environment variable, so a failing
+		 * interleaving can be replayed, or a new seed if it is not set.
+		 */
+		static uint64_t seed();
+	};
+};
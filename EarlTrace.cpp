@@ -0,0 +1,201 @@
+/*******************************************************************************
+ * Copyright (c) 2014, Niall Frederick Weedon and other Contributors
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without modification, 
+ * are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, this 
+ * list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ * this list of conditions and the following disclaimer in the documentation and/or 
+ * other materials provided with the distribution.
+ * 
+ * 3. Neither the name of the copyright holder nor the names of its contributors may
+ * be used to endorse or promote products derived from this software without 
+ * specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE 
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE 
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL 
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR 
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, 
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE 
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *******************************************************************************/
+#include "EarlTrace.h"
+#include "EarlFile.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+
+namespace Earl {
+	bool Trace::tracing = false;
+	uint64_t Trace::origin = 0;
+	// buffers[0] belongs to the runner, buffers[n + 1] to worker n.
+	std::vector<TraceBuffer> Trace::buffers;
+
+	const size_t Trace::runner;
+
+	/**
+	 * escape
+	 * -------------------
+	 * Escape s for use inside a JSON string.
+	 */
+	static std::string escape(const std::string& s) {
+		std::string escaped;
+		char code[8];
+
+		for(char c : s) {
+			if(c == '"' || c == '\\') {
+				escaped += '\\';
+				escaped += c;
+			} else if(static_cast<unsigned char>(c) < 0x20) {
+				std::snprintf(code, sizeof(code), "\\u%04x", c);
+				escaped += code;
+			} else {
+				escaped += c;
+			}
+		}
+
+		return escaped;
+	}
+
+	static uint64_t steadyNanoseconds() {
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	/**
+	 * Trace::enable
+	 * -------------------
+	 * Start (or stop) recording, discarding any recorded events.
+	 * @param enabled - Set to true to record events.
+	 */
+	void Trace::enable(bool enabled) {
+		tracing = enabled;
+		buffers.clear();
+		origin = steadyNanoseconds();
+		prepare(1);
+	}
+
+	/**
+	 * Trace::prepare
+	 * -------------------
+	 * Make sure the buffers of workers [0, workers) exist. Must be
+	 * called before the workers start.
+	 * @param workers - The number of workers about to start
+	 */
+	void Trace::prepare(size_t workers) {
+		if(tracing && buffers.size() < workers + 1) {
+			buffers.resize(workers + 1);
+		}
+	}
+
+	/**
+	 * Trace::now
+	 * -------------------
+	 * Returns the time since recording started, in nanoseconds.
+	 */
+	uint64_t Trace::now() {
+		return steadyNanoseconds() - origin;
+	}
+
+	/**
+	 * Trace::slot
+	 * -------------------
+	 * Returns the next slot of a worker's ring. Once the ring holds
+	 * TRACE_BUFFER_EVENTS events, the oldest are reused.
+	 */
+	TraceEvent& Trace::slot(size_t worker) {
+		TraceBuffer& buffer = buffers[worker == runner ? 0 : worker + 1];
+		return buffer.events[buffer.written++ % TRACE_BUFFER_EVENTS];
+	}
+
+	/**
+	 * Trace::record
+	 * -------------------
+	 * Record a span on a worker's timeline. Must only be called
+	 * by the worker itself, or once the worker has finished.
+	 * @param worker - The worker's index, or Trace::runner
+	 * @param category - The kind of span ("test", "hook", "suite"...)
+	 * @param name - The span's name
+	 * @param begin - When the span began, from Trace::now
+	 * @param end - When the span ended, from Trace::now
+	 */
+	void Trace::record(size_t worker, const char* category, const char* name, uint64_t begin, uint64_t end) {
+		if(!tracing) {
+			return;
+		}
+
+		TraceEvent& event = slot(worker);
+		size_t length = std::strlen(name);
+
+		if(length >= TRACE_NAME_LENGTH) {
+			length = TRACE_NAME_LENGTH - 1;
+
+			// Don't split a UTF-8 sequence.
+			while(length > 0 && (static_cast<unsigned char>(name[length]) & 0xC0) == 0x80) {
+				length--;
+			}
+		}
+
+		std::memcpy(event.name, name, length);
+		event.name[length] = '\0';
+		event.category = category;
+		event.begin = begin;
+		event.end = end;
+	}
+
+	void Trace::record(size_t worker, const char* category, const std::string& name, uint64_t begin, uint64_t end) {
+		record(worker, category, name.c_str(), begin, end);
+	}
+
+	/**
+	 * Trace::write
+	 * -------------------
+	 * Write every recorded event to path as Chrome trace-event
+	 * JSON, then discard them.
+	 * @param path - The file to write
+	 * @return Whether the file was written.
+	 */
+	bool Trace::write(const std::string& path) {
+		std::ostringstream json;
+		const char* separator = "";
+
+		json << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+
+		for(size_t tid = 0; tid < buffers.size(); tid++) {
+			const TraceBuffer& buffer = buffers[tid];
+			size_t count = std::min<size_t>(buffer.written, TRACE_BUFFER_EVENTS);
+			// Start from the oldest event still in the ring.
+			size_t first = buffer.written > count ? buffer.written % TRACE_BUFFER_EVENTS : 0;
+
+			json << separator << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << tid
+				 << ",\"args\":{\"name\":\"" << (tid == 0 ? std::string("runner") : "worker " + std::to_string(tid - 1)) << "\"}}";
+			separator = ",\n";
+
+			for(size_t i = 0; i < count; i++) {
+				const TraceEvent& event = buffer.events[(first + i) % count];
+
+				// Timestamps and durations are in microseconds.
+				json << separator << "{\"name\":\"" << escape(event.name) << "\",\"cat\":\"" << event.category
+					 << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << tid
+					 << ",\"ts\":" << event.begin / 1000 << "." << (event.begin % 1000) / 100
+					 << ",\"dur\":" << (event.end - event.begin) / 1000 << "." << ((event.end - event.begin) % 1000) / 100 << "}";
+			}
+		}
+
+		json << "]}\n";
+
+		std::string contents = json.str();
+		enable(tracing);
+		return File::writeAtomically(path, contents.data(), contents.size());
+	}
+};
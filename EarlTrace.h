@@ -0,0 +1,137 @@
+/*******************************************************************************
+ * Copyright (c) 2014, Niall Frederick Weedon and other Contributors
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without modification, 
+ * are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, this 
+ * list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ * this list of conditions and the following disclaimer in the documentation and/or 
+ * other materials provided with the distribution.
+ * 
+ * 3. Neither the name of the copyright holder nor the names of its contributors may
+ * be used to endorse or promote products derived from this software without 
+ * specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE 
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE 
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL 
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR 
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, 
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE 
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *******************************************************************************/
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Events kept per worker before the oldest are overwritten.
+#define TRACE_BUFFER_EVENTS 65536
+// Longest event name kept, including the terminator. Longer
+// names are truncated.
+#define TRACE_NAME_LENGTH 96
+
+namespace Earl {
+	// One span of time on a worker's timeline. Names are copied in
+	// place so that recording an event never allocates.
+	struct TraceEvent {
+		char name[TRACE_NAME_LENGTH];
+		const char* category;
+		uint64_t begin, end;
+	};
+
+	// A ring of events written only by the worker which owns it. The
+	// ring is allocated up front; its pages are only touched as the
+	// ring fills.
+	struct TraceBuffer {
+		std::unique_ptr<TraceEvent[]> events;
+		// The number of events ever written; the ring's next slot
+		// is written % TRACE_BUFFER_EVENTS.
+		size_t written;
+		// Keeps neighbouring workers' buffers off the same cache line.
+		char padding[64];
+
+		TraceBuffer() : events(new TraceEvent[TRACE_BUFFER_EVENTS]), written(0) { };
+	};
+
+	/**
+	 * Trace
+	 * -------------------
+	 * Records what each worker does and when, and writes it out as
+	 * Chrome trace-event JSON (which can be loaded into Perfetto or
+	 * chrome://tracing). Each worker writes into its own ring buffer,
+	 * so recording never takes a lock.
+	 */
+	class Trace {
+	private:
+		static bool tracing;
+		static uint64_t origin;
+		// buffers[0] belongs to the runner, buffers[n + 1] to worker n.
+		static std::vector<TraceBuffer> buffers;
+
+		static TraceEvent& slot(size_t);
+	public:
+		// Pass as the worker to record an event on the runner's timeline.
+		static const size_t runner = static_cast<size_t>(-1);
+
+		/**
+		 * Trace::enable
+		 * -------------------
+		 * Start (or stop) recording, discarding any recorded events.
+		 * @param enabled - Set to true to record events.
+		 */
+		static void enable(bool);
+
+		static bool enabled() { return tracing; };
+
+		/**
+		 * Trace::prepare
+		 * -------------------
+		 * Make sure the buffers of workers [0, workers) exist. Must be
+		 * called before the workers start.
+		 * @param workers - The number of workers about to start
+		 */
+		static void prepare(size_t);
+
+		/**
+		 * Trace::now
+		 * -------------------
+		 * Returns the time since recording started, in nanoseconds.
+		 */
+		static uint64_t now();
+
+		/**
+		 * Trace::record
+		 * -------------------
+		 * Record a span on a worker's timeline. Must only be called
+		 * by the worker itself, or once the worker has finished.
+		 * @param worker - The worker's index, or Trace::runner
+		 * @param category - The kind of span ("test", "hook", "suite"...)
+		 * @param name - The span's name
+		 * @param begin - When the span began, from Trace::now
+		 * @param end - When the span ended, from Trace::now
+		 */
+		static void record(size_t, const char*, const char*, uint64_t, uint64_t);
+		static void record(size_t, const char*, const std::string&, uint64_t, uint64_t);
+
+		/**
+		 * Trace::write
+		 * -------------------
+		 * Write every recorded event to path as Chrome trace-event
+		 * JSON, then discard them.
+		 * @param path - The file to write
+		 * @return Whether the file was written.
+		 */
+		static bool write(const std::string&);
+	};
+};
@@ -0,0 +1,169 @@
+/*******************************************************************************
+ * Copyright (c) 2014, Niall Frederick Weedon and other Contributors
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without modification, 
+ * are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, this 
+ * list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ * this list of conditions and the following disclaimer in the documentation and/or 
+ * other materials provided with the distribution.
+ * 
+ * 3. Neither the name of the copyright holder nor the names of its contributors may
+ * be used to endorse or promote products derived from this software without 
+ * specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE 
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE 
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL 
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR 
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, 
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE 
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *******************************************************************************/
+#include "EarlUsage.h"
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+
+#ifdef __linux__
+	#include <sys/resource.h>
+#endif
+
+namespace Earl {
+	// Where the calling thread's test started measuring from, or -1.
+	static thread_local long baseline = -1;
+
+	/**
+	 * Usage::thread
+	 * -------------------
+	 * Returns the faults and context switches of the calling
+	 * thread so far. The peak growth is zero.
+	 */
+	ResourceUsage Usage::thread() {
+		ResourceUsage usage = { 0, 0, 0, 0, 0 };
+#ifdef __linux__
+		struct rusage counters;
+
+		if(getrusage(RUSAGE_THREAD, &counters) == 0) {
+			usage.minorFaults = counters.ru_minflt;
+			usage.majorFaults = counters.ru_majflt;
+			usage.voluntarySwitches = counters.ru_nvcsw;
+			usage.involuntarySwitches = counters.ru_nivcsw;
+		}
+#endif
+		return usage;
+	}
+
+	/**
+	 * Usage::since
+	 * -------------------
+	 * Returns the faults and context switches of the calling
+	 * thread since start, and the peak growth since Usage::begin.
+	 * @param start - An earlier result of Usage::thread
+	 */
+	ResourceUsage Usage::since(const ResourceUsage& start) {
+		ResourceUsage usage = thread();
+
+		usage.minorFaults -= start.minorFaults;
+		usage.majorFaults -= start.majorFaults;
+		usage.voluntarySwitches -= start.voluntarySwitches;
+		usage.involuntarySwitches -= start.involuntarySwitches;
+		usage.peakGrowth = peakGrowth() > 0 ? peakGrowth() : 0;
+		return usage;
+	}
+
+	/**
+	 * Usage::begin
+	 * -------------------
+	 * Start measuring the peak growth of the calling thread's test.
+	 * The peak resident set size is shared by the whole process, so
+	 * it is only reset when the test has the process to itself;
+	 * otherwise only growth beyond the previous peak is seen.
+	 * @param exclusive - Whether no other test is running
+	 */
+	void Usage::begin(bool exclusive) {
+#ifdef __linux__
+		// Writing 5 to clear_refs resets the peak to the current size.
+		if(exclusive) {
+			std::ofstream clearRefs("/proc/self/clear_refs");
+
+			if(clearRefs << "5" << std::flush) {
+				baseline = status("VmRSS");
+				return;
+			}
+		}
+
+		baseline = status("VmHWM");
+#else
+		baseline = 0;
+#endif
+	}
+
+	/**
+	 * Usage::end
+	 * -------------------
+	 * Stop measuring the calling thread's test.
+	 */
+	void Usage::end() {
+		baseline = -1;
+	}
+
+	/**
+	 * Usage::peakGrowth
+	 * -------------------
+	 * Returns how far the peak resident set size has risen since the
+	 * calling thread's Usage::begin, in kilobytes, or -1 if it was
+	 * never called.
+	 */
+	long Usage::peakGrowth() {
+		if(baseline < 0) {
+			return -1;
+		}
+
+		long growth = status("VmHWM") - baseline;
+		return growth > 0 ? growth : 0;
+	}
+
+	/**
+	 * Usage::status
+	 * -------------------
+	 * Returns a field of /proc/self/status in kilobytes, such as
+	 * "VmRSS" or "VmHWM", or zero if it cannot be read.
+	 * @param field - The field's name
+	 */
+	long Usage::status(const std::string& field) {
+		std::ifstream file("/proc/self/status");
+		std::string line;
+		std::string prefix = field + ":";
+
+		while(std::getline(file, line)) {
+			if(line.compare(0, prefix.size(), prefix) == 0) {
+				return std::strtol(line.c_str() + prefix.size(), nullptr, 10);
+			}
+		}
+
+		return 0;
+	}
+
+	/**
+	 * Usage::format
+	 * -------------------
+	 * Format usage as columns for a test's result line.
+	 * @param usage - The usage to format
+	 */
+	std::string Usage::format(const ResourceUsage& usage) {
+		std::ostringstream columns;
+
+		columns << "faults " << usage.minorFaults << " minor/" << usage.majorFaults << " major, "
+				<< "switches " << usage.voluntarySwitches << " voluntary/" << usage.involuntarySwitches << " involuntary, "
+				<< "peak RSS +" << usage.peakGrowth << " KiB";
+		return columns.str();
+	}
+};
@@ -0,0 +1,114 @@
+/*******************************************************************************
+ * Copyright (c) 2014, Niall Frederick Weedon and other Contributors
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without modification, 
+ * are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, this 
+ * list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ * this list of conditions and the following disclaimer in the documentation and/or 
+ * other materials provided with the distribution.
+ * 
+ * 3. Neither the name of the copyright holder nor the names of its contributors may
+ * be used to endorse or promote products derived from this software without 
+ * specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE 
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE 
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL 
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR 
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, 
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE 
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *******************************************************************************/
+#pragma once
+
+#include <string>
+
+namespace Earl {
+	// What a test cost the machine while it ran.
+	struct ResourceUsage {
+		long minorFaults, majorFaults;
+		long voluntarySwitches, involuntarySwitches;
+		// How far the peak resident set size rose, in kilobytes.
+		long peakGrowth;
+	};
+
+	/**
+	 * Usage
+	 * -------------------
+	 * Measures the page faults and context switches of a thread, with
+	 * getrusage(RUSAGE_THREAD), and the peak resident set size of the
+	 * process, from /proc/self/status. Only supported on Linux;
+	 * elsewhere every figure is zero.
+	 */
+	class Usage {
+	public:
+		/**
+		 * Usage::thread
+		 * -------------------
+		 * Returns the faults and context switches of the calling
+		 * thread so far. The peak growth is zero.
+		 */
+		static ResourceUsage thread();
+
+		/**
+		 * Usage::since
+		 * -------------------
+		 * Returns the faults and context switches of the calling
+		 * thread since start, and the peak growth since Usage::begin.
+		 * @param start - An earlier result of Usage::thread
+		 */
+		static ResourceUsage since(const ResourceUsage&);
+
+		/**
+		 * Usage::begin
+		 * -------------------
+		 * Start measuring the peak growth of the calling thread's test.
+		 * The peak resident set size is shared by the whole process, so
+		 * it is only reset when the test has the process to itself;
+		 * otherwise only growth beyond the previous peak is seen.
+		 * @param exclusive - Whether no other test is running
+		 */
+		static void begin(bool);
+
+		/**
+		 * Usage::end
+		 * -------------------
+		 * Stop measuring the calling thread's test.
+		 */
+		static void end();
+
+		/**
+		 * Usage::peakGrowth
+		 * -------------------
+		 * Returns how far the peak resident set size has risen since the
+		 * calling thread's Usage::begin, in kilobytes, or -1 if it was
+		 * never called.
+		 */
+		static long peakGrowth();
+
+		/**
+		 * Usage::status
+		 * -------------------
+		 * Returns a field of /proc/self/status in kilobytes, such as
+		 * "VmRSS" or "VmHWM", or zero if it cannot be read.
+		 * @param field - The field's name
+		 */
+		static long status(const std::string&);
+
+		/**
+		 * Usage::format
+		 * -------------------
+		 * Format usage as columns for a test's result line.
+		 * @param usage - The usage to format
+		 */
+		static std::string format(const ResourceUsage&);
+	};
+};
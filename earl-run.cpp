@@ -0,0 +1,695 @@
+/*******************************************************************************
+ * Copyright (c) 2014, Niall Frederick Weedon and other Contributors
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without modification, 
+ * are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, this 
+ * list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ * this list of conditions and the following disclaimer in the documentation and/or 
+ * other materials provided with the distribution.
+ * 
+ * 3. Neither the name of the copyright holder nor the names of its contributors may
+ * be used to endorse or promote products derived from this software without 
+ * specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE 
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE 
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL 
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR 
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, 
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE 
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *******************************************************************************/
+// earl-run: runs several Earl test binaries at once, sharing the job
+// budget of an enclosing `make -j` through the GNU make jobserver, and
+// merges their reports into one summary.
+//
+//	earl-run [-j jobs] [--history file] [--verbose] [binary or directory...]
+//
+// Directories are searched for executables named test-*. Binaries which
+// took longest last time are started first, so that a slow binary is not
+// left running on its own at the end. Each binary is given one job slot,
+// and EARL_MAX_THREADS=1 keeps it to one test thread.
+#include "Earl.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <limits>
+#include <sstream>
+#include <unordered_map>
+
+#ifndef _WIN32
+	#include <cerrno>
+	#include <csignal>
+	#include <dirent.h>
+	#include <fcntl.h>
+	#include <poll.h>
+	#include <sys/stat.h>
+	#include <sys/wait.h>
+	#include <unistd.h>
+#endif
+
+// First line of the timing history file.
+#define HISTORY_HEADER "earl-run-history 1"
+// Where timings are kept unless --history is given.
+#define DEFAULT_HISTORY ".earl-run-history"
+
+using namespace Earl;
+
+#ifdef _WIN32
+int main() {
+	Print::line("earl-run requires a POSIX system.", RED);
+	return 1;
+}
+#else
+// The counts from one or more REPORT_HEADER lines.
+struct Report {
+	int run;
+	int passed;
+	int failed;
+	int pending;
+	int cached;
+	int flaky;
+};
+
+struct Job {
+	std::string path;
+	// Seconds taken last time, or a negative number if unknown.
+	double expected;
+	pid_t pid;
+	// The jobserver token this job holds, or -1 for the token every
+	// make child is implicitly given.
+	int token;
+	std::string outputPath;
+	std::string reportPath;
+	std::chrono::steady_clock::time_point started;
+	double seconds;
+	int status;
+	Report report;
+};
+
+// Written to by the SIGCHLD handler so that poll wakes up.
+static int childPipe[2] = { -1, -1 };
+// A duplicate of the jobserver's read end, which the SIGCHLD handler
+// closes so that a blocked read cannot miss a binary exiting.
+static volatile int tokenFd = -1;
+
+/**
+ * onChild
+ * -------------------
+ * SIGCHLD handler. Wakes the main loop to reap the child,
+ * and interrupts any jobserver read.
+ */
+static void onChild(int) {
+	int saved = errno;
+	char wake = 0;
+	ssize_t written = write(childPipe[1], &wake, 1);
+	(void)written;
+
+	if(tokenFd >= 0) {
+		close(tokenFd);
+		tokenFd = -1;
+	}
+
+	errno = saved;
+}
+
+class Jobserver {
+	int readFd;
+	int writeFd;
+	bool fifo;
+public:
+	Jobserver() : readFd(-1), writeFd(-1), fifo(false) {}
+
+	/**
+	 * Jobserver::connect
+	 * -------------------
+	 * Find the jobserver in MAKEFLAGS, either as a pipe
+	 * (--jobserver-auth=R,W or the older --jobserver-fds=R,W)
+	 * or as a named pipe (--jobserver-auth=fifo:PATH).
+	 * @param makeflags - The value of MAKEFLAGS
+	 * @return Whether a usable jobserver was found.
+	 */
+	bool connect(const std::string& makeflags) {
+		std::istringstream words(makeflags);
+		std::string word;
+		std::string auth;
+
+		// The last option wins, as it does for make itself.
+		while(words >> word) {
+			for(const char* option : { "--jobserver-auth=", "--jobserver-fds=" }) {
+				if(word.compare(0, std::strlen(option), option) == 0) {
+					auth = word.substr(std::strlen(option));
+				}
+			}
+		}
+
+		if(auth.empty()) {
+			return false;
+		}
+
+		if(auth.compare(0, 5, "fifo:") == 0) {
+			// Our own open file descriptions, so non-blocking
+			// reads do not affect anyone else.
+			fifo = true;
+			readFd = open(auth.substr(5).c_str(), O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+			writeFd = open(auth.substr(5).c_str(), O_WRONLY | O_CLOEXEC);
+		} else if(std::sscanf(auth.c_str(), "%d,%d", &readFd, &writeFd) != 2 ||
+				  fcntl(readFd, F_GETFD) == -1 || fcntl(writeFd, F_GETFD) == -1) {
+			// make closes these unless the recipe line starts with '+'.
+			readFd = writeFd = -1;
+		}
+
+		if(readFd < 0 || writeFd < 0) {
+			readFd = writeFd = -1;
+			return false;
+		}
+
+		// Test binaries have no use for the jobserver.
+		fcntl(readFd, F_SETFD, FD_CLOEXEC);
+		fcntl(writeFd, F_SETFD, FD_CLOEXEC);
+		return true;
+	}
+
+	int fd() const { return readFd; }
+
+	/**
+	 * Jobserver::acquire
+	 * -------------------
+	 * Take a token once poll reports one may be available. Another
+	 * process can take it first, in which case a pipe read blocks
+	 * until a token comes back or a binary exits. The read goes
+	 * through tokenFd, which SIGCHLD closes, as GNU make does: a
+	 * signal arriving just before the read would otherwise be lost
+	 * and the read would block while a binary's slot sat unused.
+	 * @return The token, or -1 if none was taken.
+	 */
+	int acquire() {
+		unsigned char token;
+
+		if(tokenFd < 0) {
+			tokenFd = fcntl(readFd, F_DUPFD_CLOEXEC, 0);
+		}
+
+		// A binary which exited since the main loop last reaped
+		// has already closed tokenFd, or is about to be reaped.
+		struct pollfd wake = { childPipe[0], POLLIN, 0 };
+
+		if(tokenFd < 0 || poll(&wake, 1, 0) > 0) {
+			return -1;
+		}
+
+		return read(tokenFd, &token, 1) == 1 ? token : -1;
+	}
+
+	/**
+	 * Jobserver::release
+	 * -------------------
+	 * Return a token taken with Jobserver::acquire.
+	 * @param token - The token to return
+	 */
+	void release(int token) {
+		unsigned char byte = static_cast<unsigned char>(token);
+
+		while(write(writeFd, &byte, 1) != 1 && errno == EINTR) {
+		}
+	}
+};
+
+/**
+ * isTestBinary
+ * -------------------
+ * Returns whether path is an executable regular file.
+ */
+static bool isTestBinary(const std::string& path) {
+	struct stat info;
+	return stat(path.c_str(), &info) == 0 && S_ISREG(info.st_mode) && access(path.c_str(), X_OK) == 0;
+}
+
+/**
+ * discover
+ * -------------------
+ * Collect the binaries named on the command line, searching
+ * directories for executables named test-*.
+ * @param paths - Binaries and directories
+ * @return The binaries, in name order.
+ */
+static std::vector<std::string> discover(const std::vector<std::string>& paths) {
+	std::vector<std::string> binaries;
+
+	for(auto& path : paths) {
+		struct stat info;
+
+		if(stat(path.c_str(), &info) != 0) {
+			Print::line("earl-run: cannot find " + path, RED);
+			continue;
+		}
+
+		if(!S_ISDIR(info.st_mode)) {
+			binaries.push_back(path);
+			continue;
+		}
+
+		std::vector<std::string> found;
+		DIR* directory = opendir(path.c_str());
+
+		while(directory != nullptr) {
+			struct dirent* entry = readdir(directory);
+
+			if(entry == nullptr) {
+				closedir(directory);
+				break;
+			}
+
+			std::string name = entry->d_name;
+			std::string file = path + (path.back() == '/' ? "" : "/") + name;
+
+			if(name.compare(0, 5, "test-") == 0 && isTestBinary(file)) {
+				found.push_back(file);
+			}
+		}
+
+		std::sort(found.begin(), found.end());
+		binaries.insert(binaries.end(), found.begin(), found.end());
+	}
+
+	return binaries;
+}
+
+/**
+ * readHistory
+ * -------------------
+ * Load the seconds each binary took on its last run.
+ * @param path - The history file
+ */
+static std::unordered_map<std::string, double> readHistory(const std::string& path) {
+	std::unordered_map<std::string, double> history;
+	std::ifstream file(path);
+	std::string line;
+
+	if(!std::getline(file, line) || line != HISTORY_HEADER) {
+		return history;
+	}
+
+	while(std::getline(file, line)) {
+		std::istringstream fields(line);
+		std::string binary;
+		double seconds;
+
+		if(fields >> seconds && std::getline(fields >> std::ws, binary)) {
+			history[binary] = seconds;
+		}
+	}
+
+	return history;
+}
+
+/**
+ * writeHistory
+ * -------------------
+ * Record how long each binary took, keeping the entries
+ * of binaries which were not run this time.
+ * @param path - The history file
+ * @param history - Earlier timings
+ * @param jobs - The binaries which were run
+ */
+static void writeHistory(const std::string& path, std::unordered_map<std::string, double> history, const std::vector<Job>& jobs) {
+	std::ostringstream contents;
+
+	for(auto& job : jobs) {
+		history[job.path] = job.seconds;
+	}
+
+	contents << HISTORY_HEADER << "\n" << std::fixed << std::setprecision(3);
+
+	for(auto& entry : history) {
+		contents << entry.second << " " << entry.first << "\n";
+	}
+
+	std::string data = contents.str();
+	File::writeAtomically(path, data.data(), data.size());
+}
+
+/**
+ * readReport
+ * -------------------
+ * Sum the REPORT_HEADER lines a binary wrote,
+ * one per call to Test::runTests.
+ * @param path - The report file
+ */
+static Report readReport(const std::string& path) {
+	Report total = { 0, 0, 0, 0, 0, 0 };
+	std::ifstream file(path);
+	std::string line;
+	const std::string header = REPORT_HEADER " ";
+
+	while(std::getline(file, line)) {
+		std::istringstream fields(line.compare(0, header.size(), header) == 0 ? line.substr(header.size()) : "");
+		Report counts;
+
+		if(fields >> counts.run >> counts.passed >> counts.failed >> counts.pending >> counts.cached >> counts.flaky) {
+			total.run += counts.run;
+			total.passed += counts.passed;
+			total.failed += counts.failed;
+			total.pending += counts.pending;
+			total.cached += counts.cached;
+			total.flaky += counts.flaky;
+		}
+	}
+
+	return total;
+}
+
+/**
+ * temporaryFile
+ * -------------------
+ * Create an empty temporary file and return its path.
+ */
+static std::string temporaryFile() {
+	const char* directory = std::getenv("TMPDIR");
+	std::string pattern = std::string(directory != nullptr && *directory ? directory : "/tmp") + "/earl-run-XXXXXX";
+	std::vector<char> path(pattern.begin(), pattern.end());
+	path.push_back('\0');
+
+	int fd = mkstemp(path.data());
+
+	if(fd < 0) {
+		return "";
+	}
+
+	close(fd);
+	return path.data();
+}
+
+/**
+ * start
+ * -------------------
+ * Launch a binary with its output and report redirected
+ * to temporary files.
+ * @param job - The binary to run
+ * @param token - The jobserver token it holds, or -1
+ * @return Whether the binary was launched.
+ */
+static bool start(Job& job, int token) {
+	job.outputPath = temporaryFile();
+	job.reportPath = temporaryFile();
+	job.token = token;
+	job.started = std::chrono::steady_clock::now();
+	job.pid = fork();
+
+	if(job.pid == 0) {
+		int output = open(job.outputPath.c_str(), O_WRONLY | O_TRUNC);
+
+		if(output >= 0) {
+			dup2(output, STDOUT_FILENO);
+			dup2(output, STDERR_FILENO);
+			close(output);
+		}
+
+		signal(SIGCHLD, SIG_DFL);
+		setenv("EARL_REPORT_FILE", job.reportPath.c_str(), 1);
+		// The binary holds one job slot, so it runs one test at a time
+		// and does not reserve a CPU for its benchmarks.
+		setenv("EARL_MAX_THREADS", "1", 1);
+		execl(job.path.c_str(), job.path.c_str(), static_cast<char*>(nullptr));
+		_exit(127);
+	}
+
+	if(job.pid < 0) {
+		std::remove(job.outputPath.c_str());
+		std::remove(job.reportPath.c_str());
+		return false;
+	}
+
+	return true;
+}
+
+/**
+ * finish
+ * -------------------
+ * Collect the results of a binary which has exited, print
+ * its status line and, if it failed or verbose is set, its output.
+ * @param job - The binary which exited
+ * @param status - Its wait status
+ * @param verbose - Print output even when the binary passed
+ */
+static void finish(Job& job, int status, bool verbose) {
+	job.status = status;
+	job.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - job.started).count();
+	job.report = readReport(job.reportPath);
+
+	bool passed = WIFEXITED(status) && WEXITSTATUS(status) == 0;
+	std::ostringstream summary;
+	summary << job.path << " (" << std::fixed << std::setprecision(2) << job.seconds << "s, "
+			<< job.report.run << " tests run, " << job.report.passed << " passed";
+
+	if(!WIFEXITED(status)) {
+		summary << ", killed by signal " << WTERMSIG(status);
+	} else if(!passed) {
+		summary << ", exit code " << WEXITSTATUS(status);
+	}
+
+	summary << ")";
+
+	Print::status(passed ? "PASS " : "FAIL ", passed ? GREEN : RED, summary.str());
+
+	if(!passed || verbose) {
+		std::ifstream output(job.outputPath);
+		std::string line;
+
+		while(std::getline(output, line)) {
+			Print::line(TAB + line);
+		}
+	}
+
+	std::remove(job.outputPath.c_str());
+	std::remove(job.reportPath.c_str());
+}
+
+/**
+ * usage
+ * -------------------
+ * Print the command line options and return the exit code.
+ */
+static int usage() {
+	Print::line("usage: earl-run [-j jobs] [--history file] [--verbose] [binary or directory...]");
+	return 2;
+}
+
+int main(int argc, char** argv) {
+	std::vector<std::string> paths;
+	std::string historyPath = DEFAULT_HISTORY;
+	bool verbose = false;
+	// Without a jobserver, the number of binaries to run at once.
+	int limit = std::max<int>(std::thread::hardware_concurrency(), 1);
+	bool limitGiven = false;
+
+	for(int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+
+		if((arg == "-j" || arg == "--jobs") && i + 1 < argc) {
+			limit = std::max(std::atoi(argv[++i]), 1);
+			limitGiven = true;
+		} else if(arg.compare(0, 2, "-j") == 0 && arg.size() > 2) {
+			limit = std::max(std::atoi(arg.c_str() + 2), 1);
+			limitGiven = true;
+		} else if(arg == "--history" && i + 1 < argc) {
+			historyPath = argv[++i];
+		} else if(arg == "-v" || arg == "--verbose") {
+			verbose = true;
+		} else if(!arg.empty() && arg[0] == '-') {
+			return usage();
+		} else {
+			paths.push_back(arg);
+		}
+	}
+
+	if(paths.empty()) {
+		paths.push_back(".");
+	}
+
+	Jobserver jobserver;
+	const char* makeflags = std::getenv("MAKEFLAGS");
+	bool shared = !limitGiven && makeflags != nullptr && jobserver.connect(makeflags);
+
+	// Under make without -j (or with the jobserver hidden from us
+	// because the recipe lacks '+'), run one binary at a time, as
+	// make would.
+	if(!shared && !limitGiven && makeflags != nullptr) {
+		limit = 1;
+	}
+
+	std::unordered_map<std::string, double> history = readHistory(historyPath);
+	std::vector<Job> jobs;
+
+	for(auto& binary : discover(paths)) {
+		Job job = Job();
+		job.path = binary;
+		job.expected = history.count(binary) ? history[binary] : -1;
+		job.pid = -1;
+		job.token = -1;
+		jobs.push_back(job);
+	}
+
+	if(jobs.empty()) {
+		Print::line("earl-run: no test binaries found.", RED);
+		return 1;
+	}
+
+	// Longest first; binaries without a history might be
+	// slow, so they go before all the others.
+	std::stable_sort(jobs.begin(), jobs.end(), [](const Job& a, const Job& b) {
+		double first = a.expected < 0 ? std::numeric_limits<double>::infinity() : a.expected;
+		double second = b.expected < 0 ? std::numeric_limits<double>::infinity() : b.expected;
+		return first > second;
+	});
+
+	if(pipe(childPipe) != 0) {
+		Print::line("earl-run: cannot create pipe.", RED);
+		return 1;
+	}
+
+	for(int fd : childPipe) {
+		fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+		fcntl(fd, F_SETFD, FD_CLOEXEC);
+	}
+
+	// No SA_RESTART, so that a blocked jobserver read
+	// returns when a binary exits.
+	struct sigaction action;
+	std::memset(&action, 0, sizeof(action));
+	action.sa_handler = onChild;
+	sigemptyset(&action.sa_mask);
+	sigaction(SIGCHLD, &action, nullptr);
+
+	Print::line("> Running " + std::to_string(jobs.size()) + " test binaries" +
+				(shared ? " (sharing the make jobserver)" : " (" + std::to_string(limit) + " at a time)"));
+
+	auto began = std::chrono::steady_clock::now();
+	size_t next = 0;
+	size_t running = 0;
+	bool implicitFree = true;
+	bool tokenReady = false;
+
+	while(next < jobs.size() || running > 0) {
+		// Start as many binaries as there are tokens to run them.
+		while(next < jobs.size()) {
+			int token = -1;
+
+			if(implicitFree) {
+				implicitFree = false;
+			} else if(shared && tokenReady) {
+				tokenReady = false;
+				token = jobserver.acquire();
+
+				if(token < 0) {
+					break;
+				}
+			} else if(shared || running >= static_cast<size_t>(limit)) {
+				break;
+			}
+
+			if(!start(jobs[next], token)) {
+				Print::line("earl-run: cannot start " + jobs[next].path, RED);
+
+				if(token >= 0) {
+					jobserver.release(token);
+				} else {
+					implicitFree = true;
+				}
+
+				jobs[next].status = -1;
+				next++;
+				continue;
+			}
+
+			next++;
+			running++;
+		}
+
+		struct pollfd waits[2] = { { childPipe[0], POLLIN, 0 }, { jobserver.fd(), POLLIN, 0 } };
+		nfds_t count = shared && next < jobs.size() ? 2 : 1;
+
+		if(poll(waits, count, 1000) > 0 && count == 2 && (waits[1].revents & POLLIN)) {
+			tokenReady = true;
+		}
+
+		char drain[64];
+
+		while(read(childPipe[0], drain, sizeof(drain)) > 0) {
+		}
+
+		int status;
+		pid_t pid;
+
+		while((pid = waitpid(-1, &status, WNOHANG)) > 0) {
+			for(auto& job : jobs) {
+				if(job.pid != pid) {
+					continue;
+				}
+
+				// Return the token first, so that make can use
+				// it while the output is being printed.
+				if(job.token >= 0) {
+					jobserver.release(job.token);
+				} else {
+					implicitFree = true;
+				}
+
+				finish(job, status, verbose);
+				running--;
+			}
+		}
+	}
+
+	double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - began).count();
+	Report total = { 0, 0, 0, 0, 0, 0 };
+	double serial = 0;
+	int failedBinaries = 0;
+
+	for(auto& job : jobs) {
+		bool passed = job.pid > 0 && WIFEXITED(job.status) && WEXITSTATUS(job.status) == 0;
+		failedBinaries += passed ? 0 : 1;
+		serial += job.seconds;
+		total.run += job.report.run;
+		total.passed += job.report.passed;
+		total.failed += job.report.failed;
+		total.pending += job.report.pending;
+		total.cached += job.report.cached;
+		total.flaky += job.report.flaky;
+	}
+
+	writeHistory(historyPath, history, jobs);
+
+	std::cout << std::endl;
+	std::cout << "Summary: " << std::endl;
+	std::cout << "---------------" << std::endl;
+	std::cout << jobs.size() << " binaries run, " << jobs.size() - failedBinaries << " passed." << std::endl;
+	std::cout << total.run << " tests run, " << total.passed << " tests passed. (" << total.pending << " tests pending.)" << std::endl;
+
+	if(total.failed > 0) {
+		std::cout << total.failed << " tests failed." << std::endl;
+	}
+
+	if(total.cached > 0) {
+		std::cout << total.cached << " tests cached." << std::endl;
+	}
+
+	if(total.flaky > 0) {
+		std::cout << total.flaky << " tests flaky." << std::endl;
+	}
+
+	std::cout << std::fixed << std::setprecision(2) << elapsed << "s elapsed, " << serial << "s if run one at a time." << std::endl;
+
+	return failedBinaries == 0 ? 0 : 1;
+}
+#endif
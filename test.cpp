@@ -28,9 +28,23 @@
  * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  *******************************************************************************/ 
 #include "Earl.h"
+#include <algorithm>
+#include <atomic>
 #include <iostream>
 #include <string>
 #include <chrono>
+#include <cmath>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <limits>
+#include <mutex>
+#include <vector>
+
+#ifndef _WIN32
+	#include <sys/stat.h>
+#endif
 
 using namespace Earl;
 
@@ -156,12 +170,809 @@ bool runTests(bool async, int threads) {
 			return !result;
 		});
 
+		Test::it("isEqualBuffer -> Returns true when buffers are equal", []() -> bool {
+			std::vector<unsigned char> a((1 << 20) + 3);
+			std::vector<unsigned char> b;
+
+			for(size_t i = 0; i < a.size(); i++) {
+				a[i] = static_cast<unsigned char>(i * 31);
+			}
+			b = a;
+
+			bool result = Assert::isEqualBuffer(a.data(), b.data(), a.size());
+			result &= Assert::isEqualBuffer(a.data(), b.data(), a.size(), "isEqualBufferTest");
+			return result;
+		});
+
+		Test::it("isEqualBuffer -> Returns false when buffers differ", []() -> bool {
+			std::vector<unsigned char> a((1 << 20) + 3, 0x5a);
+			std::vector<unsigned char> b = a;
+			size_t firstMismatch;
+			b[1000] = 0;
+			b[b.size() - 1] = 0;
+
+			bool result = Assert::isEqualBuffer(a.data(), b.data(), a.size(), "isEqualBufferTest (differs)");
+			size_t mismatches = Compare::elements(a.data(), b.data(), a.size(), 1, &firstMismatch);
+			return !result && mismatches == 2 && firstMismatch == 1000;
+		});
+
+		Test::it("isEqualArray -> Returns true when arrays are equal", []() -> bool {
+			std::vector<int> a(4099, 7);
+			std::vector<int> b(4099, 7);
+
+			bool result = Assert::isEqualArray(a, b);
+			result &= Assert::isEqualArray(a.data(), b.data(), a.size(), "isEqualArrayTest");
+			return result;
+		});
+
+		Test::it("isEqualArray -> Returns false when array elements differ", []() -> bool {
+			std::vector<long long> a(4099, 7);
+			std::vector<long long> b(4099, 7);
+			size_t firstMismatch;
+			b[17] = 8;
+			b[18] = 1LL << 40;
+			b[4098] = -7;
+
+			bool result = Assert::isEqualArray(a, b, "isEqualArrayTest (differs)");
+			size_t mismatches = Compare::elements(a.data(), b.data(), a.size(), sizeof(long long), &firstMismatch);
+			result |= Assert::isEqualArray(a, std::vector<long long>(3, 7));
+			return !result && mismatches == 3 && firstMismatch == 17;
+		});
+
+		Test::it("isNear -> Returns true when values are within tolerance", []() -> bool {
+			std::vector<float> a(1027), b(1027);
+			std::vector<double> c(1027), d(1027);
+
+			for(size_t i = 0; i < a.size(); i++) {
+				a[i] = static_cast<float>(i) * 0.5f;
+				b[i] = std::nextafter(a[i], 1e9f);
+				c[i] = static_cast<double>(i) * -0.25;
+				d[i] = c[i] * (1 + 1e-12);
+			}
+			a[3] = b[3] = c[5] = d[5] = std::numeric_limits<float>::quiet_NaN();
+
+			bool result = Assert::isNear(a, b, 1, Tolerance::Ulp);
+			result &= Assert::isNear(a, b, 1e-3);
+			result &= Assert::isNear(c, d, 1e-11, Tolerance::Relative);
+			result &= Assert::isNear(c.data(), d.data(), c.size(), 1 << 14, Tolerance::Ulp, "isNearTest");
+			return result;
+		});
+
+		Test::it("isNear -> Returns false when values are outside tolerance", []() -> bool {
+			std::vector<double> a(1027, 1.0), b(1027, 1.0);
+			std::vector<float> c(1027, -2.0f), d(1027, -2.0f);
+			b[600] = 1.5;
+			b[601] = 1.001;
+			d[9] = std::nextafter(std::nextafter(-2.0f, 0.0f), 0.0f);
+			d[10] = std::numeric_limits<float>::quiet_NaN();
+
+			bool result = Assert::isNear(a, b, 1e-4, Tolerance::Absolute, "isNearTest (outside)");
+			result |= Assert::isNear(c, d, 1, Tolerance::Ulp);
+			ToleranceReport report = Compare::tolerance(a.data(), b.data(), a.size(), 1e-4, Tolerance::Absolute);
+			return !result && report.failures == 2 && report.maxIndex == 600 && report.histogram[4] == 1;
+		});
+
+		Test::it("matchesSnapshot -> Compares against, and updates, golden files", []() -> bool {
+			std::string golden = "earl-snapshot-test.golden";
+			std::string actual = "earl-snapshot-test.actual";
+			std::string lines = "first line\nsecond line\nthird line\n";
+			std::string changed = "first line\nsecond lime\nthird line\n";
+			std::remove(golden.c_str());
+
+			bool result = !Assert::matchesSnapshot(lines.data(), lines.size(), golden, "missing snapshot");
+
+			Assert::updateSnapshots(true);
+			result &= Assert::matchesSnapshot(lines.data(), lines.size(), golden);
+			Assert::updateSnapshots(false);
+
+			result &= Assert::matchesSnapshot(lines.data(), lines.size(), golden, "matching snapshot");
+			result &= !Assert::matchesSnapshot(changed.data(), changed.size(), golden, "differing snapshot");
+			result &= !Assert::matchesSnapshot(lines.data(), lines.size() - 1, golden, "truncated snapshot");
+
+			std::string binary("\0\1\2\3", 4);
+			Assert::updateSnapshots(true);
+			result &= Assert::matchesSnapshot(binary.data(), binary.size(), golden);
+			Assert::updateSnapshots(false);
+			result &= !Assert::matchesSnapshot(binary.data(), binary.size() - 1, golden, "truncated binary snapshot");
+			Assert::updateSnapshots(true);
+			result &= Assert::matchesSnapshot(lines.data(), lines.size(), golden);
+			Assert::updateSnapshots(false);
+
+			File::writeAtomically(actual, lines.data(), lines.size());
+			result &= Assert::matchesSnapshotFile(actual, golden, "matching snapshot file");
+
+			std::remove(golden.c_str());
+			std::remove(actual.c_str());
+			return result;
+		});
+
+		Test::it("writeAtomically -> Lets threads replace the same file at once", []() -> bool {
+			std::string path = "earl-atomic-test.txt";
+			std::atomic<int> failures(0);
+			std::vector<std::thread> writers;
+
+			for(int i = 0; i < 4; i++) {
+				writers.push_back(std::thread([&, i]() {
+					std::string contents(4096, static_cast<char>('a' + i));
+
+					for(int j = 0; j < 25; j++) {
+						failures += File::writeAtomically(path, contents.data(), contents.size()) ? 0 : 1;
+					}
+				}));
+			}
+
+			for(auto& writer : writers) {
+				writer.join();
+			}
+
+			MappedFile file(path);
+			bool result = failures == 0 && file.isOpen() && file.size() == 4096 &&
+						  std::count(file.data(), file.data() + file.size(), file.data()[0]) == 4096;
+
+			std::remove(path.c_str());
+			return result;
+		});
+
+		Test::it("writeAtomically -> Keeps the mode of the file it replaces", []() -> bool {
+#ifndef _WIN32
+			std::string path = "earl-mode-test.txt";
+			struct stat info;
+
+			File::writeAtomically(path, "a", 1);
+			chmod(path.c_str(), 0600);
+			bool result = File::writeAtomically(path, "b", 1) && stat(path.c_str(), &info) == 0 && (info.st_mode & 07777) == 0600;
+
+			std::remove(path.c_str());
+			return result;
+#else
+			return true;
+#endif
+		});
 	});
 
 	// Run the suite of tests and return the
 	// truthiness of the results we expect
 	Test::runTests();
-	return (Test::getTestsPassed() == 11) && (Test::getTestsFailed() == 1) && (Test::getTestsPending() == 1);
+	return (Test::getTestsPassed() == 20) && (Test::getTestsFailed() == 1) && (Test::getTestsPending() == 1);
+}
+
+bool runCachedTests(bool async) {
+	std::string cacheFile = "earl-cache-test.cache";
+	bool passed = true;
+
+	std::cout << std::endl << "Running cached suite." << std::endl;
+	std::remove(cacheFile.c_str());
+	Test::useResultCache(cacheFile);
+	Test::runAsynchronously(async);
+
+	auto registerTests = [](std::string key) {
+		Test::describe("Earl Result Cache", key, []() {
+			Test::it("Should cache a passing test", []() -> bool {
+				return true;
+			});
+
+			Test::it("Should never cache a failing test", []() -> bool {
+				return false;
+			});
+		});
+	};
+
+	// The first run has nothing cached.
+	Test::initSuite();
+	registerTests("key-1");
+	Test::runTests();
+	passed &= Test::getTestsPassed() == 1 && Test::getTestsFailed() == 1 && Test::getTestsCached() == 0;
+
+	// The second run skips the test which passed.
+	Test::initSuite();
+	registerTests("key-1");
+	Test::runTests();
+	passed &= Test::getTestsPassed() == 0 && Test::getTestsFailed() == 1 && Test::getTestsCached() == 1;
+
+	// Changing the key invalidates the cache.
+	Test::initSuite();
+	registerTests("key-2");
+	Test::runTests();
+	passed &= Test::getTestsPassed() == 1 && Test::getTestsCached() == 0;
+
+	// Forcing a full run ignores the cache.
+	Test::forceFullRun(true);
+	Test::initSuite();
+	registerTests("key-2");
+	Test::runTests();
+	passed &= Test::getTestsPassed() == 1 && Test::getTestsCached() == 0;
+	Test::forceFullRun(false);
+
+	// Later batches add to the cache rather than replacing it,
+	// including across reloads of the cache file.
+	Test::useResultCache(cacheFile);
+	Test::initSuite();
+	registerTests("key-1");
+	Test::runTests();
+	passed &= Test::getTestsPassed() == 0 && Test::getTestsCached() == 1;
+
+	// Tests after a nested keyed suite keep the outer key.
+	Test::initSuite();
+	Test::describe("Earl Result Cache Outer", "key-1", []() {
+		Test::describe("Earl Result Cache Inner", "key-3", []() {});
+
+		Test::it("Should keep the outer cache key", []() -> bool {
+			return true;
+		});
+	});
+	Test::runTests();
+
+	Test::initSuite();
+	Test::describe("Earl Result Cache Inner", "key-1", []() {
+		Test::it("Should keep the outer cache key", []() -> bool {
+			return true;
+		});
+	});
+	Test::runTests();
+	passed &= Test::getTestsCached() == 1;
+
+	// Reopening the cache forgets the keys in use, so this binary's
+	// entries for keys it no longer uses are dropped from the file.
+	// Entries written by another binary are kept.
+	std::string foreign = "0000000000000001 0000000000000002 0000000000000003\n";
+	std::string contents;
+	{
+		MappedFile cache(cacheFile);
+		contents = std::string(reinterpret_cast<const char*>(cache.data()), cache.size()) + foreign;
+	}
+	File::writeAtomically(cacheFile, contents.data(), contents.size());
+
+	Test::useResultCache(cacheFile);
+	Test::initSuite();
+	registerTests("key-2");
+	Test::runTests();
+	passed &= Test::getTestsPassed() == 1;
+	{
+		MappedFile cache(cacheFile);
+		contents = std::string(reinterpret_cast<const char*>(cache.data()), cache.size());
+	}
+	passed &= std::count(contents.begin(), contents.end(), '\n') == 3 && contents.find(foreign) != std::string::npos;
+
+	Test::useResultCache("");
+	std::remove(cacheFile.c_str());
+	return passed;
+}
+
+bool runRetriedTests(bool async) {
+	std::string statsFile = "earl-stats-test.stats";
+	static std::atomic<int> flakyAttempts;
+	bool passed;
+
+	std::cout << std::endl << "Running retried suite." << std::endl;
+	std::remove(statsFile.c_str());
+	flakyAttempts = 0;
+
+	Test::initSuite();
+	Test::runAsynchronously(async);
+	Test::setRetries(2);
+	Test::useStatsFile(statsFile);
+
+	Test::describe("Earl Retries", []() {
+		Test::it("Should pass without a retry", []() -> bool {
+			return true;
+		});
+
+		Test::it("Should report a test passing on a retry as flaky", []() -> bool {
+			return ++flakyAttempts > 1;
+		});
+
+		Test::it("Should fail after running out of retries", []() -> bool {
+			return false;
+		});
+	});
+
+	Test::runTests();
+	passed = Test::getTestsPassed() == 1 && Test::getTestsFlaky() == 1 && Test::getTestsFailed() == 1;
+	passed &= flakyAttempts == 2 && File::exists(statsFile);
+
+	Test::setRetries(0);
+	Test::useStatsFile("");
+	std::remove(statsFile.c_str());
+	return passed;
+}
+
+bool runManyTests(int threads) {
+	const int testCount = 100;
+
+	std::cout << std::endl << "Running many short tests. (" << threads << " threads)" << std::endl;
+	Test::initSuite();
+	Test::runAsynchronously(true);
+	Test::setMaxConcurrency(threads);
+
+	Test::describe("Earl Result Aggregation", [testCount]() {
+		for(int i = 0; i < testCount; i++) {
+			Test::it("Should count short test " + std::to_string(i), [i]() -> bool {
+				return i % 10 != 0;
+			});
+		}
+	});
+
+	Test::runTests();
+	return Test::getTestsPassed() == testCount - testCount / 10 && Test::getTestsFailed() == testCount / 10;
+}
+
+bool runTracedTests() {
+	std::string traceFile = "earl-trace-test.json";
+
+	std::cout << std::endl << "Running traced suite." << std::endl;
+	Test::initSuite();
+	Test::runAsynchronously(true);
+	Test::setMaxConcurrency(2);
+	Test::setTraceFile(traceFile);
+
+	Test::describe("Earl Tracing", []() {
+		Test::beforeEach([]() {});
+
+		Test::it("Should trace a test", []() -> bool {
+			return true;
+		});
+
+		Test::after([]() {});
+		Test::it("Should trace a \"quoted\" test", []() -> bool {
+			return true;
+		});
+
+		Test::it(std::string(TRACE_NAME_LENGTH * 2, 'x'), []() -> bool {
+			return true;
+		});
+	});
+
+	// Each run replaces the trace file.
+	auto readTrace = [&traceFile]() -> std::string {
+		MappedFile trace(traceFile);
+		std::string json(reinterpret_cast<const char*>(trace.data()), trace.size());
+		trace.close();
+		std::remove(traceFile.c_str());
+		return json;
+	};
+
+	Test::runTests();
+	std::string json = readTrace();
+
+	// Isolated tests are traced by the parent, as the child's events die with it.
+	Test::initSuite();
+	Test::isolateTests(true);
+	Test::describe("Earl Isolated Tracing", []() {
+		Test::it("Should trace an isolated test", []() -> bool {
+			return true;
+		});
+	});
+
+	Test::runTests();
+	Test::isolateTests(false);
+	Test::setTraceFile("");
+
+	return readTrace().find("\"name\":\"Should trace an isolated test\",\"cat\":\"test\"") != std::string::npos &&
+		json.find("\"name\":\"" + std::string(TRACE_NAME_LENGTH - 1, 'x') + "\",\"cat\":\"test\"") != std::string::npos &&
+		json.find("\"name\":\"Should trace a test\",\"cat\":\"test\"") != std::string::npos &&
+		json.find("\"name\":\"Should trace a \\\"quoted\\\" test\"") != std::string::npos &&
+		json.find("\"name\":\"beforeEach\",\"cat\":\"hook\"") != std::string::npos &&
+		json.find("\"name\":\"after\",\"cat\":\"hook\"") != std::string::npos &&
+		json.find("\"name\":\"suite barrier\"") != std::string::npos &&
+		json.find("\"name\":\"Earl Tracing\",\"cat\":\"suite\"") != std::string::npos;
+}
+
+bool runMeasuredTests() {
+	std::string metricsFile = "earl-metrics-test.prom";
+	static std::string liveMetrics;
+
+	std::cout << std::endl << "Running measured suite." << std::endl;
+	Test::initSuite();
+	Test::runAsynchronously(true);
+	Test::setMaxConcurrency(1);
+	Test::setMetricsFile(metricsFile, 20);
+
+	Test::describe("Earl Live Metrics", [metricsFile]() {
+		Test::it("Should count a completed test", []() -> bool {
+			return true;
+		});
+
+		Test::it("Should expose in-flight tests", [metricsFile]() -> bool {
+			std::this_thread::sleep_for(std::chrono::milliseconds(200));
+			MappedFile metrics(metricsFile);
+			liveMetrics = std::string(reinterpret_cast<const char*>(metrics.data()), metrics.size());
+			return metrics.isOpen();
+		});
+	});
+
+	Test::runTests();
+	Test::setMetricsFile("");
+
+	MappedFile metrics(metricsFile);
+	std::string finalMetrics(reinterpret_cast<const char*>(metrics.data()), metrics.size());
+	metrics.close();
+	std::remove(metricsFile.c_str());
+
+	return liveMetrics.find("earl_tests_completed 1\n") != std::string::npos &&
+		liveMetrics.find("earl_tests_in_flight 1\n") != std::string::npos &&
+		liveMetrics.find("earl_test_elapsed_seconds{worker=\"0\",suite=\"Earl Live Metrics\",test=\"Should expose in-flight tests\"}") != std::string::npos &&
+		finalMetrics.find("earl_tests_completed 2\n") != std::string::npos &&
+		finalMetrics.find("earl_tests_in_flight 0\n") != std::string::npos &&
+		finalMetrics.find("earl_queue_depth 0\n") != std::string::npos;
+}
+
+bool runScheduledTests() {
+	static std::atomic<int> weight(0), peakWeight(0), portHolders(0);
+	// Passes if the running tests fit in the budget (or this test runs
+	// alone) and nothing else holds the port.
+	static std::function<bool(int, bool)> occupy = [](int testWeight, bool port) -> bool {
+		int now = weight += testWeight;
+		bool fits = (now <= 4 || now == testWeight) && (!port || ++portHolders == 1);
+
+		for(int peak = peakWeight; now > peak && !peakWeight.compare_exchange_weak(peak, now);) {}
+
+		std::this_thread::sleep_for(std::chrono::milliseconds(30));
+
+		weight -= testWeight;
+		portHolders -= port ? 1 : 0;
+		return fits;
+	};
+
+	std::cout << std::endl << "Running scheduled suite." << std::endl;
+	Test::initSuite();
+	Test::runAsynchronously(true);
+	Test::setMaxConcurrency(4);
+
+	Test::describe("Earl Resource Scheduling", []() {
+		for(int i = 0; i < 4; i++) {
+			Test::it("Should run light tests in parallel", []() -> bool {
+				return occupy(1, false);
+			});
+		}
+
+		Test::it("Should hold the port alone", Resources({ "port:8080" }), []() -> bool {
+			return occupy(1, true);
+		});
+
+		Test::it("Should hold the port alone again", Resources({ "port:8080" }), []() -> bool {
+			return occupy(1, true);
+		});
+
+		Test::it("Should pack heavy tests within the budget", Resources({}, 3), []() -> bool {
+			return occupy(3, false);
+		});
+
+		Test::it("Should run tests heavier than the budget alone", Resources({}, 8), []() -> bool {
+			return occupy(8, false);
+		});
+	});
+
+	Test::describe("Earl Resource Suites", Resources({ "port:8080" }), []() {
+		Test::it("Should lock the port for each test in the suite", []() -> bool {
+			return occupy(1, true);
+		});
+
+		Test::it("Should lock the port for the next test too", []() -> bool {
+			return occupy(1, true);
+		});
+	});
+
+	Test::runTests();
+	Test::setMaxConcurrency(DEFAULT_MAX_THREADS);
+
+	return Test::getTestsPassed() == 10 && peakWeight >= 2;
+}
+
+bool runStressedTests() {
+	static std::atomic<int> completed(0);
+
+	std::cout << std::endl << "Running stressed suite." << std::endl;
+	Test::initSuite();
+	Test::runAsynchronously(true);
+
+	Test::describe("Earl Stress", []() {
+		// Every thread finishes an iteration before any starts the next.
+		Test::stress("Should release threads together", 4, 500, [](int thread, int iteration) -> bool {
+			bool ordered = completed.load() >= 4 * iteration;
+			completed++;
+			return ordered;
+		}, true);
+
+		Test::stress("Should count failed iterations per thread", 3, 200, [](int thread, int iteration) -> bool {
+			return thread != 1 || iteration % 50 != 7;
+		});
+
+		Test::scalability("Should measure a scalability curve", 20000, [](int thread, int iteration) -> bool {
+			return std::sqrt(static_cast<double>(iteration + thread)) >= 0;
+		}, [](const std::vector<ScalingStep>& steps) -> bool {
+			return Assert::hasEfficiency(steps, 1, 1.0) &&
+				steps.back().threads == std::max(static_cast<int>(std::thread::hardware_concurrency()), 1);
+		});
+
+		Test::it("Should assert a minimum efficiency", []() -> bool {
+			std::vector<int> expected = { 1, 2, 4, 6 };
+			std::vector<ScalingStep> steps = {
+				{ 1, 100, 1, 1, false },
+				{ 2, 180, 1.8, 0.9, false },
+				{ 4, 160, 1.6, 0.4, true }
+			};
+
+			return Stress::threadCounts(6) == expected &&
+				Assert::hasEfficiency(steps, 2, 0.85) &&
+				!Assert::hasEfficiency(steps, 4, 0.5, "Should report low efficiency") &&
+				!Assert::hasEfficiency(steps, 8, 0.1);
+		});
+	});
+
+	Test::runTests();
+
+	return Test::getTestsPassed() == 3 && Test::getTestsFailed() == 1 && completed == 2000;
+}
+
+bool runUsageTests(bool isolate) {
+	// Touches every page of size bytes, so that they count as resident.
+	static std::function<void(size_t)> touch = [](size_t size) {
+		std::vector<char> memory(size);
+
+		for(size_t i = 0; i < size; i += 4096) {
+			memory[i] = 1;
+		}
+	};
+
+	std::cout << std::endl << "Running " << (isolate ? "isolated" : "measured") << " usage suite." << std::endl;
+	Test::initSuite();
+	Test::runAsynchronously(isolate);
+	Test::trackResourceUsage(true);
+	Test::isolateTests(isolate);
+
+	Test::describe("Earl Resource Usage", [isolate]() {
+		Test::it("Should measure peak memory growth", []() -> bool {
+			touch(32 << 20);
+			return Assert::isWithinMemory(64 << 20) && !Assert::isWithinMemory(16 << 20);
+		});
+
+		if(isolate) {
+			Test::it("Should fail a test which crashes", []() -> bool {
+				std::raise(SIGTERM);
+				return true;
+			});
+		}
+	});
+
+	Test::runTests();
+	Test::trackResourceUsage(false);
+	Test::isolateTests(false);
+
+	return Test::getTestsPassed() == 1 && Test::getTestsFailed() == (isolate ? 1 : 0);
+}
+
+// Counts the copies of itself alive, to show that generated
+// tests are only held in memory while they run.
+struct LiveProbe {
+	static std::atomic<int> live, peak;
+
+	LiveProbe() { track(); }
+	LiveProbe(const LiveProbe&) { track(); }
+	~LiveProbe() { live--; }
+
+	static void track() {
+		int now = ++live;
+		for(int high = peak; now > high && !peak.compare_exchange_weak(high, now);) {}
+	}
+};
+
+std::atomic<int> LiveProbe::live(0), LiveProbe::peak(0);
+
+// Counts the befores and afters run around generated suites.
+static std::atomic<int> generatedHooks(0);
+
+int runGeneratedSuite(bool async, int cases) {
+	Test::initSuite();
+	Test::runAsynchronously(async);
+
+	Test::describe("Earl Filtered Suite", []() {
+		Test::it("Should be filtered along with generated tests", []() -> bool {
+			return true;
+		});
+	});
+
+	// Befores and afters go with the first generated test.
+	Test::before([]() {
+		generatedHooks++;
+	});
+	Test::after([]() {
+		generatedHooks++;
+	});
+
+	int index = 0;
+	Test::generate("Earl Generated Suite", [&index, cases](GeneratedTest& test) -> bool {
+		if(index == cases) {
+			return false;
+		}
+
+		LiveProbe probe;
+		test.description = "case " + std::to_string(index++);
+		test.test = [probe]() -> bool {
+			return true;
+		};
+		return true;
+	});
+
+	Test::runTests();
+	return Test::getTestsPassed();
+}
+
+bool runGeneratedTests(bool async) {
+	std::cout << std::endl << "Running " << (async ? "asynchronous" : "synchronous") << " generated suite." << std::endl;
+	LiveProbe::peak = 0;
+	generatedHooks = 0;
+
+	bool passed = runGeneratedSuite(async, 200) == 201 && LiveProbe::peak <= 16;
+
+	Test::setShard(0, 2);
+	int firstShard = runGeneratedSuite(async, 200);
+	Test::setShard(1, 2);
+	int secondShard = runGeneratedSuite(async, 200);
+	Test::setShard(0, 1);
+
+	// Cases 1, 10-19 and 100-199.
+	Test::setFilter("case 1");
+	passed &= runGeneratedSuite(async, 200) == 111;
+	Test::setFilter("");
+
+	return passed && firstShard > 0 && secondShard > 0 && firstShard + secondShard == 201 && LiveProbe::live == 0 && generatedHooks == 8;
+}
+
+// Defined in test-coverage.cpp, which is built with coverage instrumentation.
+bool plantedTarget(const uint8_t* data, size_t size);
+
+// Fixtures entered by the calling thread, and targets running at once.
+static thread_local int fixtureDepth = 0;
+static std::atomic<int> fuzzTargets(0);
+
+// Recurses until the thread's stack overflows.
+static int overflowStack(int depth) {
+	volatile char frame[1024];
+	frame[0] = static_cast<char>(depth);
+	return depth < 0 ? 0 : overflowStack(depth + 1) + frame[0];
+}
+
+bool runFuzzedTests() {
+	bool passed = true;
+
+	std::cout << std::endl << "Running fuzzed suite." << std::endl;
+	Test::initSuite();
+	Test::runAsynchronously(true);
+	Test::setFuzzRuns(2000);
+
+	// Inputs run in a child process, so the fixtures are checked
+	// from the target rather than counted.
+	Test::describe("Earl Fuzzing Fixtures", []() {
+		Test::beforeEach([]() {
+			fixtureDepth++;
+		});
+
+		Test::afterEach([]() {
+			fixtureDepth--;
+		});
+
+		Test::fuzz("Should run each input alone between the fixtures", [](const uint8_t* data, size_t size) -> bool {
+			bool alone = ++fuzzTargets == 1;
+			std::this_thread::yield();
+			fuzzTargets--;
+			return alone && fixtureDepth > 0 && size <= FUZZ_MAX_LENGTH;
+		});
+	});
+
+	Test::runTests();
+	passed &= Test::getTestsPassed() == 1 && Test::getTestsFailed() == 0;
+
+	Test::initSuite();
+	Test::describe("Earl Fuzzing", []() {
+		Test::fuzz("Should find an input which fails", [](const uint8_t* data, size_t size) -> bool {
+			return size == 0 || data[0] < 0x80;
+		});
+
+		Test::fuzz("Should fail a test whose target crashes", [](const uint8_t* data, size_t size) -> bool {
+			if(size > 0 && data[0] >= 0x80) {
+				std::raise(SIGSEGV);
+			}
+			return true;
+		});
+
+		Test::it("Should report a crash without ending the run", []() -> bool {
+			FuzzReport report = Fuzz::run([](const uint8_t* data, size_t size) -> bool {
+				if(size > 0 && data[0] >= 0x80) {
+					std::raise(SIGSEGV);
+				}
+				return true;
+			}, 2, 20000, "");
+
+			return report.failed && report.crashSignal == SIGSEGV && report.failure.size() == 1;
+		});
+
+		Test::it("Should save the input of a target overflowing its stack", []() -> bool {
+			FuzzReport report = Fuzz::run([](const uint8_t* data, size_t size) -> bool {
+				return size == 0 || data[0] < 0x80 || overflowStack(0) == 0;
+			}, 1, 20000, "");
+
+			return report.failed && !report.inputLost && report.crashSignal == SIGSEGV && report.failure.size() == 1;
+		});
+
+		Test::it("Should report a target exiting without its input", []() -> bool {
+			FuzzReport report = Fuzz::run([](const uint8_t*, size_t) -> bool {
+				std::_Exit(3);
+			}, 1, 10, "");
+
+			return report.failed && report.inputLost && report.exitCode == 3 && report.failure.empty();
+		});
+
+		Test::it("Should find a planted input by following coverage", []() -> bool {
+			FuzzReport seeded = Fuzz::run(plantedTarget, 1, 1, "");
+			FuzzReport report = Fuzz::run(plantedTarget, 1, 1000000, "");
+
+			return seeded.instrumented && report.instrumented && report.features > seeded.features &&
+				   report.failed && report.failure == "FUZZ";
+		});
+
+		Test::it("Should minimise a failing input", []() -> bool {
+			FuzzTarget target = [](const uint8_t* data, size_t size) -> bool {
+				return std::string(reinterpret_cast<const char*>(data), size).find('E') == std::string::npos;
+			};
+			FuzzTarget crasher = [](const uint8_t*, size_t) -> bool {
+				std::raise(SIGSEGV);
+				return true;
+			};
+
+			return Fuzz::minimize(target, "xxxEyyy") == "E" && Fuzz::fails(crasher, "");
+		});
+	});
+
+	Test::runTests();
+	Test::setFuzzRuns(DEFAULT_FUZZ_RUNS);
+
+	return passed && Test::getTestsPassed() == 5 && Test::getTestsFailed() == 2;
+}
+
+bool runPinnedTests() {
+	static std::mutex placementMutex;
+	static std::vector<int> benchmarkCpus, workerCpus;
+
+	std::cout << std::endl << "Running pinned suite." << std::endl;
+	Test::initSuite();
+	Test::runAsynchronously(true);
+	Test::setMaxConcurrency(2);
+	Test::spreadAcrossNumaNodes(true);
+
+	Test::describe("Earl CPU Affinity", []() {
+		Test::it("Should parse CPU lists", []() -> bool {
+			std::vector<int> expected = { 0, 1, 2, 5, 8, 9 };
+			return Affinity::parseCpuList("0-2,5,8-9\n") == expected;
+		});
+
+		Test::it("Should pin a worker to one CPU", []() -> bool {
+			std::lock_guard<std::mutex> lock(placementMutex);
+			workerCpus = Affinity::current();
+			return workerCpus.size() == 1;
+		});
+
+		Test::benchmark("Should run a benchmark on a reserved CPU", []() -> bool {
+			std::lock_guard<std::mutex> lock(placementMutex);
+			benchmarkCpus = Affinity::current();
+			return benchmarkCpus.size() == 1;
+		});
+
+		// Stress threads inherit the worker's mask, so it is widened first.
+		Test::scalability("Should scale across every CPU", 1000, [](int, int) -> bool {
+			return Affinity::current().size() == Affinity::available().size();
+		});
+
+		Test::stress("Should stress across every CPU", 2, 100, [](int, int) -> bool {
+			return Affinity::current().size() == Affinity::available().size();
+		});
+	});
+
+	Test::runTests();
+	Test::spreadAcrossNumaNodes(false);
+
+	// The benchmark's CPU is only reserved when there is another to share.
+	bool reserved = Affinity::available().size() < 2 || benchmarkCpus != workerCpus;
+	return Test::getTestsPassed() == 5 && reserved;
 }
 
 int main() {
@@ -169,5 +980,20 @@ int main() {
 	passed &= runTests(true, -1);
 	passed &= runTests(true, 2);
 	passed &= runTests(true, 4);
+	passed &= runCachedTests(false);
+	passed &= runCachedTests(true);
+	passed &= runRetriedTests(false);
+	passed &= runRetriedTests(true);
+	passed &= runManyTests(4);
+	passed &= runTracedTests();
+	passed &= runMeasuredTests();
+	passed &= runScheduledTests();
+	passed &= runStressedTests();
+	passed &= runUsageTests(false);
+	passed &= runUsageTests(true);
+	passed &= runGeneratedTests(false);
+	passed &= runGeneratedTests(true);
+	passed &= runFuzzedTests();
+	passed &= runPinnedTests();
 	return passed ? 0 : 1;
 }
\ No newline at end of file